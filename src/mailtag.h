@@ -41,5 +41,98 @@
 #define REPORT_WAIT_LOW_AND_TIME 213
 
 #define PROTOCOL_REPORT_BASE    300
+
+// MAIL LAYOUT
+//   buf_head[0]:    PLOAD_SIZE_TX, bytes after itself
+//   buf_head[1]:    MAILBOX
+//   buf_head[2~3]:  MAIL_TAG
+//   buf_head[4~]:   payload of the MAIL_TAG, 32-bit words from OR32
+#include <stdint.h>
+
+#define MAIL_HDR_SIZE           4
+#define MAIL_PLOAD_SIZE(h)      ((h)[0] + 1 - MAIL_HDR_SIZE)
+
+/**
+ * mail_*_t - packed views of the payload at buf_head + MAIL_HDR_SIZE
+ *  fields are read in place, whatever the alignment of buf_head
+ **/
+#pragma pack(push, 1)
+typedef struct {
+    uint32_t    bp_tick;
+} mail_tick_t;                          // MT_TICK
+
+typedef struct {
+    int32_t     pulse_pos;
+    int32_t     enc_pos;
+} mail_jnt_pos_t;
+
+typedef struct {
+    uint32_t    bp_tick;
+    mail_jnt_pos_t jnt[];               // followed by board specific words
+} mail_motion_status_t;                 // MT_MOTION_STATUS
+
+typedef struct {
+    uint32_t    bp_tick;
+    uint32_t    code;                   // ERROR_* or REPORT_*
+    uint32_t    arg[];
+} mail_error_code_t;                    // MT_ERROR_CODE
+
+typedef struct {
+    uint32_t    bp_tick;
+    uint32_t    status[];
+} mail_usb_status_t;                    // MT_USB_STATUS
+
+typedef struct {
+    uint32_t    bp_tick;
+    int32_t     switch_pos[];           // one per joint
+} mail_home_switch_t;                   // MT_HOME_SWITCH
+
+typedef struct {
+    uint32_t    bp_tick;
+    int32_t     pos[];                  // one per joint
+} mail_probed_pos_t;                    // MT_PROBED_POS
+
+typedef struct {
+    uint32_t    word;
+} mail_word_t;                          // MT_DEBUG, MT_RISC_CMD: mail_word_t[]
+#pragma pack(pop)
+
+/**
+ * mail_min_size - payload size of the fixed fields of a MAIL_TAG
+ **/
+static inline uint32_t mail_min_size (uint16_t tag)
+{
+    switch (tag) {
+    case MT_TICK:
+    case MT_MOTION_STATUS:
+    case MT_USB_STATUS:
+    case MT_HOME_SWITCH:
+    case MT_PROBED_POS:
+        return sizeof(uint32_t);
+    case MT_ERROR_CODE:
+        return sizeof(mail_error_code_t);
+    default:
+        return 0;
+    }
+}
+
+static inline uint16_t mail_tag (const uint8_t *buf_head)
+{
+    return (uint16_t) (buf_head[2] | (buf_head[3] << 8));
+}
+
+/**
+ * mail_motion_status - view of an MT_MOTION_STATUS with njoints joints
+ *  return NULL if the mail is not one or is too short
+ **/
+static inline const mail_motion_status_t *mail_motion_status (const uint8_t *buf_head, int njoints)
+{
+    if ((mail_tag (buf_head) != MT_MOTION_STATUS) ||
+        (MAIL_PLOAD_SIZE(buf_head) < (int) (sizeof(mail_motion_status_t) + njoints * sizeof(mail_jnt_pos_t)))) {
+        return 0;
+    }
+    return (const mail_motion_status_t *) (buf_head + MAIL_HDR_SIZE);
+}
+
 #endif //mailbox_tag_h
 
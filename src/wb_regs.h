@@ -215,4 +215,41 @@
                                 //                  stepper: based on PULSE_POS
 // end: registers for SSIF (Servo/Stepper InterFace)
 
+// begin: register table
+// ACCESS of a register
+#define WB_ACC_R        0x01    // readable
+#define WB_ACC_W        0x02    // writable
+#define WB_ACC_RW       0x03
+// KIND of a register
+#define WB_KIND_PLAIN   0x00    // COUNT registers of WIDTH bytes each
+#define WB_KIND_FIFO    0x01    // a FIFO port taking up to COUNT entries of WIDTH bytes
+#define WB_KIND_STROBE  0x02    // writing the last byte triggers an action
+/**
+ * WB_REG_TABLE - X-macro of the registers above, for generating typed 
+ *                accessors (see wb_regs.hpp)
+ *  X(NAME, ADDR, WIDTH, COUNT, ACCESS, KIND)
+ *  NAME is a macro itself; only use it with # or ## in X()
+ **/
+#define WB_REG_TABLE(X)                                                                   \
+    /* NAME             ADDR                            WIDTH COUNT ACCESS     KIND */     \
+    X(GPIO_SYSTEM,      GPIO_BASE | GPIO_SYSTEM,        1,    1,    WB_ACC_W,  WB_KIND_PLAIN)  \
+    X(OR32_CTRL,        JCMD_BASE | OR32_CTRL,          1,    1,    WB_ACC_W,  WB_KIND_PLAIN)  \
+    X(JCMD_CTRL,        JCMD_BASE | JCMD_CTRL,          1,    1,    WB_ACC_W,  WB_KIND_PLAIN)  \
+    X(OR32_RT_CMD,      JCMD_BASE | OR32_RT_CMD,        4,    1,    WB_ACC_W,  WB_KIND_STROBE) \
+    X(OR32_PROG,        JCMD_BASE | OR32_PROG,          4,    2,    WB_ACC_W,  WB_KIND_STROBE) \
+    X(JCMD_SYNC_CMD,    JCMD_BASE | JCMD_SYNC_CMD,      2,    16,   WB_ACC_W,  WB_KIND_FIFO)   \
+    X(OR32_MAILBOX,     JCMD_BASE | OR32_MAILBOX,       1,    64,   WB_ACC_R,  WB_KIND_PLAIN)  \
+    X(SSIF_PULSE_TYPE,  SSIF_BASE | SSIF_PULSE_TYPE,    1,    1,    WB_ACC_W,  WB_KIND_PLAIN)  \
+    X(SSIF_ENC_TYPE,    SSIF_BASE | SSIF_ENC_TYPE,      1,    1,    WB_ACC_W,  WB_KIND_PLAIN)  \
+    X(SSIF_LOAD_POS,    SSIF_BASE | SSIF_LOAD_POS,      2,    1,    WB_ACC_W,  WB_KIND_STROBE) \
+    X(SSIF_RST_POS,     SSIF_BASE | SSIF_RST_POS,       2,    1,    WB_ACC_W,  WB_KIND_STROBE) \
+    X(SSIF_SWITCH_EN,   SSIF_BASE | SSIF_SWITCH_EN,     2,    1,    WB_ACC_RW, WB_KIND_PLAIN)  \
+    X(SSIF_INDEX_EN,    SSIF_BASE | SSIF_INDEX_EN,      2,    1,    WB_ACC_RW, WB_KIND_PLAIN)  \
+    X(SSIF_INDEX_LOCK,  SSIF_BASE | SSIF_INDEX_LOCK,    2,    1,    WB_ACC_R,  WB_KIND_PLAIN)  \
+    X(SSIF_MAX_PWM,     SSIF_BASE | SSIF_MAX_PWM,       1,    12,   WB_ACC_W,  WB_KIND_PLAIN)  \
+    X(SSIF_PULSE_POS,   SSIF_BASE | SSIF_PULSE_POS,     4,    12,   WB_ACC_R,  WB_KIND_PLAIN)  \
+    X(SSIF_ENC_POS,     SSIF_BASE | SSIF_ENC_POS,       4,    12,   WB_ACC_R,  WB_KIND_PLAIN)  \
+    X(SSIF_SWITCH_POS,  SSIF_BASE | SSIF_SWITCH_POS,    4,    12,   WB_ACC_R,  WB_KIND_PLAIN)
+// end: register table
+
 #endif // __wb_regs_h__
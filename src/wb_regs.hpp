@@ -0,0 +1,133 @@
+/*
+ * Copyright © 2009-2010 Yishin Li <ysli@araisrobo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * wb_regs.hpp - typed wishbone registers, generated from WB_REG_TABLE
+ *
+ *  every register of WB_REG_TABLE gets a descriptor wou::<NAME>_t, e.g.:
+ *      wou::write<wou::SSIF_MAX_PWM_t, 3> (w_param, 180);
+ *      wou::request<wou::SSIF_ENC_POS_t> (w_param);
+ *      int32_t pos = wou::read<wou::SSIF_ENC_POS_t, 2> (w_param);
+ *  access mode, index and size are checked at compile time;
+ *  the accessors go to the unchecked wou_wr() and wou_rd()
+ **/
+
+#ifndef _WB_REGS_HPP_
+#define _WB_REGS_HPP_
+
+#include <stdint.h>
+#include <string.h>
+
+#include "wou.h"
+#include "wb_regs.h"
+
+namespace wou {
+
+namespace detail {
+
+template <unsigned WIDTH> struct uint_of;
+template <> struct uint_of<1> { typedef uint8_t  type; };
+template <> struct uint_of<2> { typedef uint16_t type; };
+template <> struct uint_of<4> { typedef uint32_t type; };
+
+} // namespace detail
+
+/**
+ * <NAME>_t - register descriptor
+ * @addr:       wishbone address of the first register
+ * @width:      size in bytes of one register
+ * @count:      number of registers (FIFO: max entries per write)
+ * @access:     WB_ACC_R, WB_ACC_W or WB_ACC_RW
+ * @kind:       WB_KIND_PLAIN, WB_KIND_FIFO or WB_KIND_STROBE
+ * @fifo:       registers share one FIFO port
+ **/
+#define WB_REG_DESCRIPTOR(NAME, ADDR, WIDTH, COUNT, ACCESS, KIND)               \
+    struct NAME##_t {                                                           \
+        typedef detail::uint_of<WIDTH>::type value_type;                       \
+        static constexpr uint16_t   addr   = (ADDR);                            \
+        static constexpr uint16_t   width  = (WIDTH);                           \
+        static constexpr uint16_t   count  = (COUNT);                           \
+        static constexpr uint8_t    access = (ACCESS);                          \
+        static constexpr uint8_t    kind   = (KIND);                            \
+        static constexpr bool       fifo   = ((KIND) == WB_KIND_FIFO);          \
+        static constexpr const char *name () { return #NAME; }                  \
+    };
+
+WB_REG_TABLE(WB_REG_DESCRIPTOR)
+
+#undef WB_REG_DESCRIPTOR
+
+/**
+ * write - write the I-th register of Reg
+ **/
+template <class Reg, unsigned I = 0>
+inline void write (wou_param_t *w_param, typename Reg::value_type value)
+{
+    static_assert (Reg::access & WB_ACC_W, "register is read-only");
+    static_assert (I < Reg::count, "register index out of range");
+    static_assert (!Reg::fifo || (I == 0), "FIFO port takes no index");
+    wou_wr (w_param, Reg::addr + (Reg::fifo ? 0 : I * Reg::width), Reg::width,
+            (const uint8_t *) &value);
+}
+
+/**
+ * write - write N registers of Reg starting from the I-th one in one packet
+ *  for a FIFO port: push N entries
+ **/
+template <class Reg, unsigned I = 0, unsigned N>
+inline void write (wou_param_t *w_param, const typename Reg::value_type (&values)[N])
+{
+    static_assert (Reg::access & WB_ACC_W, "register is read-only");
+    static_assert ((I + N) <= Reg::count, "register index out of range");
+    static_assert (!Reg::fifo || (I == 0), "FIFO port takes no index");
+    static_assert ((N * Reg::width) <= MAX_DSIZE, "exceeds MAX_DSIZE");
+    wou_wr (w_param, Reg::addr + I * Reg::width, N * Reg::width,
+            (const uint8_t *) values);
+}
+
+/**
+ * request - issue a WB_RD_CMD for N registers of Reg starting from the I-th one
+ **/
+template <class Reg, unsigned I = 0, unsigned N = Reg::count - I>
+inline void request (wou_param_t *w_param)
+{
+    static_assert (Reg::access & WB_ACC_R, "register is write-only");
+    static_assert (!Reg::fifo, "FIFO port is not readable");
+    static_assert ((I + N) <= Reg::count, "register index out of range");
+    static_assert ((N * Reg::width) <= MAX_DSIZE, "exceeds MAX_DSIZE");
+    wou_rd (w_param, Reg::addr + I * Reg::width, N * Reg::width);
+}
+
+/**
+ * read - the latest value of the I-th register of Reg received from FPGA
+ **/
+template <class Reg, unsigned I = 0>
+inline typename Reg::value_type read (wou_param_t *w_param)
+{
+    typename Reg::value_type value;
+
+    static_assert (Reg::access & WB_ACC_R, "register is write-only");
+    static_assert (!Reg::fifo, "FIFO port is not readable");
+    static_assert (I < Reg::count, "register index out of range");
+    memcpy (&value, wou_reg_ptr (w_param, Reg::addr + I * Reg::width),
+            sizeof (value));
+    return value;
+}
+
+} // namespace wou
+
+#endif  /* _WB_REGS_HPP_ */
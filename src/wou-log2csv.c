@@ -0,0 +1,136 @@
+/**
+ * wou-log2csv.c - convert a log of wou_log_open() to CSV
+ *
+ * usage: wou-log2csv <log file> [<csv file>]
+ *  writes to stdout without a csv file
+ **/
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "wou_log.h"
+
+static void put_value (FILE *fp, const wlog_col_t *col, const uint8_t *column, uint32_t row)
+{
+    uint64_t    u64;
+    uint32_t    u32;
+
+    if (col->type == WLOG_U64) {
+        memcpy (&u64, column + row * sizeof(uint64_t), sizeof(uint64_t));
+        fprintf (fp, "%" PRIu64, u64);
+        return;
+    }
+    memcpy (&u32, column + row * sizeof(uint32_t), sizeof(uint32_t));
+    if (col->type == WLOG_I32) {
+        fprintf (fp, "%" PRId32, (int32_t) u32);
+    } else {
+        fprintf (fp, "%" PRIu32, u32);
+    }
+}
+
+int main (int argc, char *argv[])
+{
+    const wlog_hdr_t *hdr;
+    const wlog_col_t *cols;
+    const wlog_blk_t *blk;
+    const uint8_t   *map;
+    static uint32_t col_off[65536];
+    uint64_t        off;
+    uint64_t        rows;
+    struct stat     st;
+    FILE            *fp;
+    uint32_t        r;
+    int             fd;
+    int             i;
+
+    if ((argc < 2) || (argc > 3)) {
+        fprintf (stderr, "usage: %s <log file> [<csv file>]\n", argv[0]);
+        return 1;
+    }
+    fd = open (argv[1], O_RDONLY);
+    if (fd < 0) {
+        fprintf (stderr, "%s: %s\n", argv[1], strerror(errno));
+        return 1;
+    }
+    if ((fstat (fd, &st) != 0) || ((size_t) st.st_size < sizeof(wlog_hdr_t))) {
+        fprintf (stderr, "%s: not a wou log\n", argv[1]);
+        return 1;
+    }
+    map = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+    if (map == MAP_FAILED) {
+        fprintf (stderr, "%s: %s\n", argv[1], strerror(errno));
+        return 1;
+    }
+
+    hdr = (const wlog_hdr_t *) map;
+    cols = (const wlog_col_t *) (map + sizeof(wlog_hdr_t));
+    if ((hdr->magic != WLOG_MAGIC) || (hdr->version != WLOG_VERSION) ||
+        (hdr->hdr_size > st.st_size) ||
+        (sizeof(wlog_hdr_t) + hdr->ncols * sizeof(wlog_col_t) > hdr->hdr_size)) {
+        fprintf (stderr, "%s: not a wou log\n", argv[1]);
+        return 1;
+    }
+    off = sizeof(wlog_blk_t);
+    for (i = 0; i < hdr->ncols; i++) {
+        col_off[i] = off;
+        off += (uint64_t) cols[i].width * hdr->block_rows;
+    }
+    if (off != hdr->blk_size) {
+        fprintf (stderr, "%s: bad block size %u\n", argv[1], hdr->blk_size);
+        return 1;
+    }
+
+    fp = stdout;
+    if (argc == 3) {
+        fp = fopen (argv[2], "w");
+        if (fp == NULL) {
+            fprintf (stderr, "%s: %s\n", argv[2], strerror(errno));
+            return 1;
+        }
+    }
+    for (i = 0; i < hdr->ncols; i++) {
+        fprintf (fp, "%s%.*s", i ? "," : "", WLOG_NAME_SIZE, cols[i].name);
+    }
+    fprintf (fp, "\n");
+
+    rows = 0;
+    for (off = hdr->hdr_size; off + hdr->blk_size <= (uint64_t) st.st_size;
+         off += hdr->blk_size) {
+        blk = (const wlog_blk_t *) (map + off);
+        if ((blk->magic != WLOG_BLK_MAGIC) || (blk->rows > hdr->block_rows)) {
+            fprintf (stderr, "%s: bad block at offset %" PRIu64 "\n", argv[1], off);
+            break;
+        }
+        for (r = 0; r < blk->rows; r++) {
+            for (i = 0; i < hdr->ncols; i++) {
+                if (i) {
+                    fputc (',', fp);
+                }
+                put_value (fp, &cols[i], map + off + col_off[i], r);
+            }
+            fputc ('\n', fp);
+        }
+        rows += blk->rows;
+    }
+    if (off < (uint64_t) st.st_size) {
+        fprintf (stderr, "%s: %" PRIu64 " trailing bytes\n", argv[1],
+                 (uint64_t) st.st_size - off);
+    }
+    fprintf (stderr, "%" PRIu64 " records\n", rows);
+
+    munmap ((void *) map, st.st_size);
+    if (fp != stdout) {
+        fclose (fp);
+    }
+    return 0;
+}
+
+// vim:sw=4:sts=4:et:
@@ -67,6 +67,12 @@ void rt_wou_flush (wou_param_t *w_param)
     return;
 }
 
+/* emergency stop: RT_ABORT bypasses the pending WOU-Frames */
+int wou_abort_now (wou_param_t *w_param, int discard, uint32_t *latency_ns)
+{
+    return board_abort_now (w_param->board, discard, latency_ns);
+}
+
 /* read/write multiple wishbone registers */
 void wou_cmd (wou_param_t *w_param, const uint8_t func, const uint16_t wb_addr, 
              const uint16_t dsize, const uint8_t *data)
@@ -82,6 +88,201 @@ void wou_cmd (wou_param_t *w_param, const uint8_t func, const uint16_t wb_addr,
   return;
 }
 
+/* unchecked write/read commands for wb_regs.hpp */
+void wou_wr (wou_param_t *w_param, const uint16_t wb_addr, const uint16_t dsize, 
+             const uint8_t *data)
+{
+  wou_append_wr (w_param->board, wb_addr, dsize, data);
+}
+
+void wou_rd (wou_param_t *w_param, const uint16_t wb_addr, const uint16_t dsize)
+{
+  wou_append_rd (w_param->board, wb_addr, dsize);
+}
+
+/* issue a batch of wou commands */
+int wou_cmdv (wou_param_t *w_param, const wou_op_t *ops, int n)
+{
+  return board_cmdv (w_param->board, ops, n);
+}
+
+/* non-blocking wou_cmd(): -EAGAIN if the WOU-Frame window is full */
+int wou_try_cmd (wou_param_t *w_param, const uint8_t func, const uint16_t wb_addr, 
+                 const uint16_t dsize, const uint8_t *data, int *occupancy)
+{
+  int ret;
+
+  if (dsize > MAX_DSIZE) {
+    ERRP ("ERROR Trying to write to too many registers (%d > %d)\n",
+          dsize, MAX_DSIZE);
+    return INVALID_DATA;
+  }
+
+  ret = wou_append_wait (w_param->board, func, wb_addr, dsize, data, 0);
+  if (occupancy) {
+    *occupancy = wou_occupancy (w_param->board);
+  }
+
+  return ret;
+}
+
+/* bounded-wait wou_cmd(): -ETIMEDOUT if the WOU-Frame window is still full */
+int wou_cmd_timeout (wou_param_t *w_param, const uint8_t func, const uint16_t wb_addr, 
+                     const uint16_t dsize, const uint8_t *data, uint32_t timeout_us)
+{
+  if (dsize > MAX_DSIZE) {
+    ERRP ("ERROR Trying to write to too many registers (%d > %d)\n",
+          dsize, MAX_DSIZE);
+    return INVALID_DATA;
+  }
+
+  return wou_append_wait (w_param->board, func, wb_addr, dsize, data, 
+                          (int64_t) timeout_us * 1000);
+}
+
+/**
+ * wou_throttle - statistics of producers throttled by the WOU-Frame window
+ **/
+void wou_throttle (wou_param_t *w_param, wou_throttle_t *stat)
+{
+    throttle_t *t;
+
+    t = &(w_param->board->wou->throttle);
+    stat->eagain = t->eagain;
+    stat->timeouts = t->timeouts;
+    stat->waits = t->waits;
+    stat->wait_ns = t->wait_ns;
+    stat->wait_ns_max = t->wait_ns_max;
+    stat->occupancy = wou_occupancy (w_param->board);
+    stat->capacity = NR_OF_CLK - NR_OF_RSV;
+    return;
+}
+
+/* pump USB I/O until pred(ctx) holds */
+int wou_wait_until (wou_param_t *w_param, libwou_pred_fn pred, void *ctx, 
+                    uint32_t timeout_us)
+{
+    int64_t timeout_ns;
+
+    timeout_ns = (timeout_us == UINT32_MAX) ? -1 : (int64_t) timeout_us * 1000;
+    return board_wait_until (w_param->board, pred, ctx, timeout_ns);
+}
+
+typedef struct {
+    const uint8_t   *reg;
+    uint8_t         mask;
+    uint8_t         value;
+} reg_cond_t;
+
+static int reg_cond (void *ctx)
+{
+    const reg_cond_t *c = ctx;
+    return ((*(c->reg) & c->mask) == c->value);
+}
+
+/* wait until ((wou register[wb_addr] & mask) == value) */
+int wou_wait_reg (wou_param_t *w_param, uint16_t wb_addr, uint8_t mask, 
+                  uint8_t value, uint32_t timeout_us)
+{
+    reg_cond_t  c;
+
+    c.reg = &(w_param->board->wb_reg_map[wb_addr]);
+    c.mask = mask;
+    c.value = value;
+    return wou_wait_until (w_param, reg_cond, &c, timeout_us);
+}
+
+/* seal pending wou commands and return a ticket for them */
+wou_ticket_t wou_fence (wou_param_t *w_param)
+{
+    return board_fence (w_param->board);
+}
+
+int wou_is_acked (wou_param_t *w_param, wou_ticket_t ticket)
+{
+    return board_is_acked (w_param->board, ticket);
+}
+
+typedef struct {
+    board_t         *board;
+    wou_ticket_t    ticket;
+} ack_cond_t;
+
+static int ack_cond (void *ctx)
+{
+    const ack_cond_t *c = ctx;
+    return board_is_acked (c->board, c->ticket);
+}
+
+/* wait until FPGA acknowledges the ticket */
+int wou_wait_acked (wou_param_t *w_param, wou_ticket_t ticket, uint32_t timeout_us)
+{
+    ack_cond_t  c;
+
+    c.board = w_param->board;
+    c.ticket = ticket;
+    return wou_wait_until (w_param, ack_cond, &c, timeout_us);
+}
+
+/* issue a WB_RD_CMD and complete it through cb(ctx, ...) */
+int wou_read_async (wou_param_t *w_param, uint16_t wb_addr, uint16_t dsize, 
+                    libwou_read_cb_fn cb, void *ctx)
+{
+  if (dsize > MAX_DSIZE) {
+    ERRP ("ERROR Trying to read too many registers (%d > %d)\n",
+          dsize, MAX_DSIZE);
+    return INVALID_DATA;
+  }
+
+  return board_read_async (w_param->board, wb_addr, dsize, cb, ctx);
+}
+
+/* write a register range of any length */
+int wou_write_range (wou_param_t *w_param, uint16_t wb_addr, uint32_t len, 
+                     const uint8_t *src, wou_ticket_t *ticket)
+{
+    return board_write_range (w_param->board, wb_addr, len, src, ticket);
+}
+
+/* read a register range of any length; cb(ctx, ...) on completion */
+int wou_read_range (wou_param_t *w_param, uint16_t wb_addr, uint32_t len, 
+                    uint8_t *dst, libwou_range_cb_fn cb, void *ctx)
+{
+    return board_read_range (w_param->board, wb_addr, len, dst, cb, ctx);
+}
+
+/* WOU-Frame templates: record once, patch and send every cycle */
+wou_tmpl_t *wou_tmpl_new (void)
+{
+    return wouf_tmpl_new ();
+}
+
+int wou_tmpl_cmd (wou_tmpl_t *tmpl, const uint8_t func, const uint16_t wb_addr, 
+                  const uint16_t dsize, const uint8_t *data, int *field)
+{
+    return wouf_tmpl_cmd (tmpl, func, wb_addr, dsize, data, field);
+}
+
+int wou_tmpl_seal (wou_tmpl_t *tmpl)
+{
+    return wouf_tmpl_seal (tmpl);
+}
+
+int wou_tmpl_patch (wou_tmpl_t *tmpl, int field, const uint8_t *data)
+{
+    return wouf_tmpl_patch (tmpl, field, data);
+}
+
+int wou_tmpl_send (wou_param_t *w_param, wou_tmpl_t *tmpl)
+{
+    return board_tmpl_send (w_param->board, tmpl, -1);
+}
+
+void wou_tmpl_free (wou_tmpl_t *tmpl)
+{
+    wouf_tmpl_free (tmpl);
+}
+
 /**
  * wou_update - update wou registers if it's appeared in USB RX BUF
  **/
@@ -159,13 +360,43 @@ void wou_init (wou_param_t *w_param, const char *device_type,
 int wou_prog_risc(wou_param_t *w_param, const char *binfile)
 {
 	int ret;
-	ret = board_risc_prog(w_param->board, binfile);
+	ret = board_risc_prog(w_param->board, binfile, 0);
 	return ret;
 }
 
+int wou_prog_risc_cached(wou_param_t *w_param, const char *binfile)
+{
+	return board_risc_prog(w_param->board, binfile, 1);
+}
+
+void wou_fpga_stats (wou_param_t *w_param, wou_fpga_stats_t *stats)
+{
+    *stats = w_param->board->wou->fpga_stats;
+}
+
+void wou_set_hot_attach (wou_param_t *w_param, int enable)
+{
+    w_param->board->wou->hot_attach = enable;
+}
+
+void wou_prog_stats (wou_param_t *w_param, wou_prog_stats_t *stats)
+{
+    *stats = w_param->board->wou->prog_stats;
+}
+
 /* set wou callback functions */
 
 /* set wou mailbox callback function */
+wou_mbox_sub_t *wou_mbox_subscribe (wou_param_t *w_param, uint32_t tags, uint32_t depth)
+{
+    return board_mbox_subscribe (w_param->board, tags, depth);
+}
+
+void wou_mbox_unsubscribe (wou_param_t *w_param, wou_mbox_sub_t *sub)
+{
+    board_mbox_unsubscribe (w_param->board, sub);
+}
+
 void wou_set_mbox_cb (wou_param_t *w_param, libwou_mailbox_cb_fn callback)
 {
     w_param->board->wou->mbox_callback = callback;
@@ -182,6 +413,13 @@ void wou_set_rt_cmd_cb(wou_param_t *w_param, libwou_rt_cmd_cb_fn callback)
     w_param->board->wou->rt_cmd_callback = callback;
 }
 
+void wou_set_progress_cb(wou_param_t *w_param, libwou_progress_cb_fn callback,
+                         void *ctx)
+{
+    w_param->board->wou->prog_callback = callback;
+    w_param->board->wou->prog_ctx = ctx;
+}
+
 
 /**
  * wou_connect_usb - Establishes a wou USB connection 
@@ -214,6 +452,136 @@ int wou_connect(wou_param_t *w_param)
     return ret;
 }
 
+/* non-blocking connect */
+int wou_connect_start (wou_param_t *w_param, const char *binfile)
+{
+    return board_connect_start (w_param->board, binfile);
+}
+
+int wou_connect_poll (wou_param_t *w_param, uint32_t *wait_us)
+{
+    return board_connect_poll (w_param->board, wait_us);
+}
+
+void wou_connect_stats (wou_param_t *w_param, wou_conn_stats_t *stats)
+{
+    *stats = w_param->board->wou->conn.stats;
+}
+
+int wou_snapshot_save (wou_param_t *w_param, const char *path)
+{
+    return board_snapshot_save (w_param->board, path);
+}
+
+void wou_set_snapshot_path (wou_param_t *w_param, const char *path)
+{
+    w_param->board->wou->snap_path = path;
+}
+
+int wou_restore (wou_param_t *w_param, const char *path, wou_ticket_t *ticket)
+{
+    return board_restore (w_param->board, path, ticket);
+}
+
+void wou_reconn_stats (wou_param_t *w_param, wou_reconn_stats_t *stats)
+{
+    *stats = w_param->board->wou->link.stats;
+}
+
+int wou_clock_config (wou_param_t *w_param, uint32_t bp_ns, uint32_t window)
+{
+    return board_clock_config (w_param->board, bp_ns, window);
+}
+
+int wou_clock_tick_time (wou_param_t *w_param, uint64_t tick, uint64_t *t_ns)
+{
+    return board_clock_tick_time (w_param->board, tick, t_ns);
+}
+
+int wou_clock_next_send (wou_param_t *w_param, uint32_t margin_ns,
+                         uint64_t *send_ns, uint64_t *tick)
+{
+    return board_clock_next_send (w_param->board, margin_ns, send_ns, tick);
+}
+
+void wou_clock_stats (wou_param_t *w_param, wou_clock_stats_t *stats)
+{
+    board_clock_stats (w_param->board, stats);
+}
+
+int wou_sfifo_config (wou_param_t *w_param, const wou_sfifo_cfg_t *cfg,
+                      libwou_sfifo_cb_fn cb, void *ctx)
+{
+    return board_sfifo_config (w_param->board, cfg, cb, ctx);
+}
+
+uint32_t wou_sfifo_credits (wou_param_t *w_param)
+{
+    return board_sfifo_credits (w_param->board);
+}
+
+void wou_sfifo_stats (wou_param_t *w_param, wou_sfifo_stats_t *stats)
+{
+    board_sfifo_stats (w_param->board, stats);
+}
+
+int wou_rpc_call (wou_param_t *w_param, const wou_rpc_req_t *req,
+                  libwou_rpc_cb_fn cb, void *ctx)
+{
+    return board_rpc_call (w_param->board, req, cb, ctx);
+}
+
+int wou_rpc_status (wou_param_t *w_param, int id)
+{
+    return board_rpc_status (w_param->board, id);
+}
+
+typedef struct {
+    board_t     *board;
+    int         id;
+} rpc_cond_t;
+
+static int rpc_cond (void *ctx)
+{
+    const rpc_cond_t *c = ctx;
+    return (board_rpc_status (c->board, c->id) != -EINPROGRESS);
+}
+
+int wou_rpc_wait (wou_param_t *w_param, int id, uint32_t timeout_us)
+{
+    rpc_cond_t  c;
+    int         ret;
+
+    c.board = w_param->board;
+    c.id = id;
+    ret = wou_wait_until (w_param, rpc_cond, &c, timeout_us);
+    if (ret != 0) {
+        return ret;
+    }
+    return board_rpc_status (w_param->board, id);
+}
+
+void wou_rpc_stats (wou_param_t *w_param, wou_rpc_stats_t *stats)
+{
+    *stats = w_param->board->wou->rpc.stats;
+}
+
+int wou_log_open (wou_param_t *w_param, const char *path, uint32_t tags,
+                  int nwords, const wou_log_reg_t *regs, int nregs)
+{
+    return board_log_open (w_param->board, path, tags, nwords, regs, nregs);
+}
+
+int wou_log_close (wou_param_t *w_param)
+{
+    return board_log_close (w_param->board);
+}
+
+void wou_log_stats (wou_param_t *w_param, wou_log_stats_t *stats)
+{
+    board_log_stats (w_param->board, stats);
+}
+
 
 /* Closes a wou connection */
 void wou_close(wou_param_t *w_param)
@@ -41,9 +41,374 @@ typedef struct {
         struct board* board;
 } wou_param_t;
 
+/**
+ * wou_throttle_t - how often and how long producers were throttled 
+ *                  because of a full WOU-Frame window
+ * @eagain:         wou_try_cmd() returned -EAGAIN
+ * @timeouts:       wou_cmd_timeout() returned -ETIMEDOUT
+ * @waits:          producers blocked for an empty WOU-Frame
+ * @wait_ns:        accumulated blocking time in nano-seconds
+ * @wait_ns_max:    the longest blocking time in nano-seconds
+ * @occupancy:      WOU-Frames waiting for ACK
+ * @capacity:       producers get throttled when (occupancy == capacity)
+ **/
+typedef struct {
+    uint32_t    eagain;
+    uint32_t    timeouts;
+    uint32_t    waits;
+    uint64_t    wait_ns;
+    uint64_t    wait_ns_max;
+    int         occupancy;
+    int         capacity;
+} wou_throttle_t;
+
+/**
+ * wou_ticket_t - identify a sealed WOU-Frame
+ * @epoch:          times of TID wrapping around when the frame was sealed
+ * @tid:            TID of the WOU-Frame
+ **/
+typedef struct {
+    uint32_t    epoch;
+    uint8_t     tid;
+} wou_ticket_t;
+
+/**
+ * wou_op_t - a wou command for wou_cmdv()
+ * @func:           WB_WR_CMD or WB_RD_CMD
+ * @wb_addr:        wishbone address
+ * @dsize:          data size in bytes, up to MAX_DSIZE
+ * @data:           data to write; ignored by WB_RD_CMD
+ **/
+typedef struct {
+    uint8_t         func;
+    uint16_t        wb_addr;
+    uint16_t        dsize;
+    const uint8_t   *data;
+} wou_op_t;
+
+/**
+ * wou_prog_stats_t - statistics of the latest wou_prog_risc()
+ * @bytes:          image size in bytes
+ * @frames:         WOU-Frames sent for the image
+ * @elapsed_ns:     from the first frame to the ACK of the last image frame
+ * @bytes_per_sec:  throughput of the image
+ * @cached:         (1) the upload was skipped, see wou_prog_risc_cached()
+ **/
+typedef struct {
+    uint32_t    bytes;
+    uint32_t    frames;
+    uint64_t    elapsed_ns;
+    uint32_t    bytes_per_sec;
+    int         cached;
+} wou_prog_stats_t;
+
+/**
+ * wou_fpga_stats_t - time in nano-seconds spent on each phase of 
+ *                    programming the FPGA by wou_connect()
+ * @bytes:          bitstream size
+ * @map_ns:         mapping and checking the bitfile
+ * @reconfig_ns:    forcing the FPGA into RECONFIG mode
+ * @reset_ns:       resetting the CPLD
+ * @send_ns:        sending the bitstream
+ * @settle_ns:      waiting for the FPGA to start up
+ * @probe_ns:       probing the running design for hot-attach
+ * @hot_attach:     (1) the bitstream was running already, not programmed
+ * @connect_ns:     the whole wou_connect()
+ **/
+typedef struct {
+    uint32_t    bytes;
+    uint64_t    map_ns;
+    uint64_t    reconfig_ns;
+    uint64_t    reset_ns;
+    uint64_t    send_ns;
+    uint64_t    settle_ns;
+    uint64_t    probe_ns;
+    int         hot_attach;
+    uint64_t    connect_ns;
+} wou_fpga_stats_t;
+
+/* phases of wou_connect_poll() */
+enum wou_conn_state {
+    WOU_CONN_IDLE = 0,
+    WOU_CONN_USB_OPEN,      // open and reset the FTDI device
+    WOU_CONN_ATTACH,        // hot-attach or prepare the bitfile
+    WOU_CONN_RECONFIG,      // force the FPGA into RECONFIG mode
+    WOU_CONN_BITSTREAM,     // send the bitstream
+    WOU_CONN_GBN,           // start GO-BACK-N
+    WOU_CONN_FIRST_ACK,     // wait for the first ACK
+    WOU_CONN_RISC,          // load the RISC image
+    WOU_CONN_DONE,
+    WOU_CONN_FAILED
+};
+
+/**
+ * wou_conn_stats_t - time in nano-seconds spent on each connect phase,
+ *                    including the waits for the FPGA
+ * @usb_open_ns:    WOU_CONN_USB_OPEN
+ * @reconfig_ns:    WOU_CONN_ATTACH and WOU_CONN_RECONFIG
+ * @bitstream_ns:   WOU_CONN_BITSTREAM, till the FPGA is up
+ * @risc_ns:        WOU_CONN_RISC
+ * @first_ack_ns:   WOU_CONN_GBN and WOU_CONN_FIRST_ACK
+ * @total_ns:       from wou_connect_start() to WOU_CONN_DONE
+ * @hot_attach:     (1) the FPGA was not programmed, see wou_set_hot_attach()
+ **/
+typedef struct {
+    uint64_t    usb_open_ns;
+    uint64_t    reconfig_ns;
+    uint64_t    bitstream_ns;
+    uint64_t    risc_ns;
+    uint64_t    first_ack_ns;
+    uint64_t    total_ns;
+    int         hot_attach;
+} wou_conn_stats_t;
+
+/**
+ * wou_reconn_stats_t - fast reconnects after USB errors, see board_reconnect()
+ * @count:          reconnects completed
+ * @reopen:         reconnects which had to reopen the device
+ * @retries:        failed attempts, e.g. the device was still unplugged
+ * @link_ns:        latest: from detecting the error till the link is back
+ * @recovery_ns:    latest: from detecting the error till the first ACK of 
+ *                  the resent woufs
+ * @max_recovery_ns: the longest recovery_ns
+ **/
+typedef struct {
+    uint32_t    count;
+    uint32_t    reopen;
+    uint32_t    retries;
+    uint64_t    link_ns;
+    uint64_t    recovery_ns;
+    uint64_t    max_recovery_ns;
+} wou_reconn_stats_t;
+
+/* a mailbox subscriber, refer to wou_mbox_subscribe() */
+typedef struct wou_mbox_sub wou_mbox_sub_t;
+
+#define WOU_MBOX_TAG(t)     ((uint32_t) 1 << (t))   // wou_mbox_subscribe() tags of MT_*
+#define WOU_MBOX_ALL        0xFFFFFFFF              // any tag, including tags >= 32
+#define WOU_MBOX_MAX_SUBS   8
+
+#define WOU_MAIL_NR_TAGS    32      // MT_* handled by wou_mail_dispatch_t
+
+/* view: payload of the MAIL_TAG, cast to its mail_*_t of mailtag.h */
+typedef void (*libwou_mail_handler_fn)(void *ctx, const void *view, uint32_t size,
+                                       uint64_t rx_time_ns);
+
+/**
+ * wou_mail_dispatch_t - mail handlers indexed by MAIL_TAG
+ * @fn, @ctx:       handler of each tag
+ * @min_size:       payload size of the fixed fields of each tag
+ * @dispatched:     mails handed to a handler
+ * @short_mails:    mails shorter than min_size, dropped
+ * @unhandled:      mails of a tag without handler
+ **/
+typedef struct {
+    libwou_mail_handler_fn fn[WOU_MAIL_NR_TAGS];
+    void        *ctx[WOU_MAIL_NR_TAGS];
+    uint32_t    min_size[WOU_MAIL_NR_TAGS];
+    uint64_t    dispatched;
+    uint64_t    short_mails;
+    uint64_t    unhandled;
+} wou_mail_dispatch_t;
+
+/**
+ * wou_mbox_stats_t - counters of a mailbox subscriber
+ * @posted:         mails queued by the RX parser
+ * @dropped:        mails lost because the ring was full
+ * @drained:        mails consumed by wou_mbox_drain()
+ * @high_water:     the most mails ever pending in the ring
+ * @depth:          size of the ring
+ **/
+typedef struct {
+    uint64_t    posted;
+    uint64_t    dropped;
+    uint64_t    drained;
+    uint32_t    high_water;
+    uint32_t    depth;
+} wou_mbox_stats_t;
+
+#define WOU_RPC_MAX         32      // pending wou_rpc_call() requests
+
+/**
+ * wou_rpc_req_t - a request to the RISC firmware and its reply
+ * @type, @val:     SYNC_USB_CMD type and immediate data, e.g. RISC_CMD_TYPE
+ *                  and RCMD_UPDATE_POS_REQ; (type == 0) sends nothing, for
+ *                  requests the caller issued itself (e.g. MACHINE_PARAM)
+ * @reply_tag:      MT_* of the reply mail, < WOU_MAIL_NR_TAGS
+ * @reply_word:     payload word of the reply compared ...
+ * @reply_mask:     ... under the mask ...
+ * @reply_value:    ... with the value; (reply_mask == 0) any mail of the tag
+ * @timeout_us:     (0) wait forever
+ **/
+typedef struct {
+    uint16_t    type;
+    uint32_t    val;
+    uint16_t    reply_tag;
+    uint16_t    reply_word;
+    uint32_t    reply_mask;
+    uint32_t    reply_value;
+    uint32_t    timeout_us;
+} wou_rpc_req_t;
+
+/**
+ * libwou_rpc_cb_fn - completion of wou_rpc_call()
+ * @status:     0 on reply, -ETIMEDOUT, or -ECANCELED by wou_close()
+ * @reply:      payload of the reply mail, as the mail_*_t of mailtag.h;
+ *              valid only during the callback, NULL without a reply
+ * @latency_ns: from wou_rpc_call() to the USB read bringing the reply
+ **/
+typedef void (*libwou_rpc_cb_fn)(void *ctx, int status, int id, const void *reply,
+                                 uint32_t size, uint64_t latency_ns);
+
+/**
+ * wou_rpc_stats_t - counters of wou_rpc_call()
+ * @unmatched:      mails of a tag awaited by requests which matched none
+ * @max_in_flight:  the most requests ever pending at once
+ * @latency_*_ns:   round-trip latency of the completed requests
+ **/
+typedef struct {
+    uint64_t    issued;
+    uint64_t    completed;
+    uint64_t    timeouts;
+    uint64_t    cancelled;
+    uint64_t    unmatched;
+    uint32_t    max_in_flight;
+    uint64_t    latency_min_ns;
+    uint64_t    latency_max_ns;
+    uint64_t    latency_sum_ns;
+} wou_rpc_stats_t;
+
+/**
+ * wou_sfifo_cfg_t - the SYNC command FIFO of the FPGA, see wou_sfifo_config()
+ * @depth:          SFIFO size in SYNC words; (0) no credit model
+ * @words_per_bp:   SYNC words the firmware takes each base period while
+ *                  there are any, e.g. the joints of a SYNC_JNT row;
+ *                  (0) only the level register and underruns update the model
+ * @low_water:      warn when fewer SYNC words are left in SFIFO; (0) never
+ * @level_addr:     (0) none; a register holding the SYNC words in SFIFO
+ * @level_size:     bytes of the level register, 1 ~ 4
+ * @level_period_us: read the level register at most this often
+ * @max_wait_us:    the longest a producer is throttled for credits
+ **/
+typedef struct {
+    uint32_t    depth;
+    uint32_t    words_per_bp;
+    uint32_t    low_water;
+    uint16_t    level_addr;
+    uint8_t     level_size;
+    uint32_t    level_period_us;
+    uint32_t    max_wait_us;
+} wou_sfifo_cfg_t;
+
+#define WOU_SFIFO_LOW       1       // level dropped below low_water
+#define WOU_SFIFO_UNDERRUN  2       // the firmware reported ERROR_SFIFO_EMPTY
+
+/* called from the thread pumping USB I/O with WOU_SFIFO_* */
+typedef void (*libwou_sfifo_cb_fn)(void *ctx, int event, uint32_t level);
+
+/**
+ * wou_sfifo_stats_t - counters of the SFIFO model
+ * @pushed, @consumed:  SYNC words
+ * @level:              the estimated SYNC words in SFIFO
+ * @throttles:          producers waiting for credits ...
+ * @throttle_timeouts:  ... which gave up after max_wait_us
+ * @throttle_ns:        total time spent waiting
+ **/
+typedef struct {
+    uint64_t    pushed;
+    uint64_t    consumed;
+    uint32_t    level;
+    uint64_t    throttles;
+    uint64_t    throttle_timeouts;
+    uint64_t    throttle_ns;
+    uint64_t    low_warnings;
+    uint64_t    underruns;
+    uint64_t    level_reads;
+} wou_sfifo_stats_t;
+
+#define WOU_CLOCK_MAX_WINDOW    256     // samples of wou_clock_config()
+
+/**
+ * wou_clock_stats_t - the fit of bp_tick onto CLOCK_MONOTONIC
+ * @locked:         (1) the fit is usable
+ * @samples:        samples taken since the (re)start, one per 16 ticks
+ * @resets:         restarts on a bp_tick going backwards
+ * @tick:           the latest bp_tick, extended to 64 bits
+ * @period_ns:      the base period measured by the host clock
+ * @drift_ppm:      period_ns against the nominal base period
+ * @jitter_ns:      spread of the mail arrival delays over the latest 16 ticks
+ **/
+typedef struct {
+    uint32_t    locked;
+    uint32_t    resets;
+    uint64_t    samples;
+    uint64_t    tick;
+    double      period_ns;
+    double      drift_ppm;
+    double      jitter_ns;
+} wou_clock_stats_t;
+
+/* a columnar log of mails, refer to wou_log_open() */
+typedef struct wou_log wou_log_t;
+
+#define WOU_LOG_MAX_COLS    32
+#define WOU_LOG_MAX_REGS    16
+
+/**
+ * wou_log_reg_t - a register sampled into each record of the log
+ * @name:           column name, up to 15 characters
+ * @dsize:          1 to 4 bytes of wb_reg_map[wb_addr]
+ * @is_signed:      (1) sign extend to int32_t
+ **/
+typedef struct {
+    const char  *name;
+    uint16_t    wb_addr;
+    uint8_t     dsize;
+    uint8_t     is_signed;
+} wou_log_reg_t;
+
+/**
+ * wou_log_stats_t - counters of the log
+ * @records:        records appended by the RX parser
+ * @dropped:        records lost to a full block ring or a write error
+ * @blocks:         blocks written by the flusher
+ * @pending:        full blocks waiting for the flusher
+ **/
+typedef struct {
+    uint64_t    records;
+    uint64_t    dropped;
+    uint32_t    blocks;
+    uint32_t    pending;
+} wou_log_stats_t;
+
+/* a recorded WOU-Frame, refer to wou_tmpl_new() */
+typedef struct wouf_tmpl wou_tmpl_t;
+
 typedef void (*libwou_mailbox_cb_fn)(const uint8_t *buf_head);
+typedef void (*libwou_mail_fn)(void *ctx, const uint8_t *buf_head, uint64_t rx_time_ns);
 typedef void (*libwou_crc_error_cb_fn)(int32_t crc_count);
 typedef void (*libwou_rt_cmd_cb_fn)(void);
+typedef void (*libwou_progress_cb_fn)(void *ctx, uint32_t done, uint32_t total);
+typedef int (*libwou_pred_fn)(void *ctx);
+/**
+ * libwou_range_cb_fn - completion of wou_read_range()
+ * @status:     0 on success; the first error of its wou_read_async() otherwise
+ * @data:       the dst buffer given to wou_read_range()
+ * @rx_time_ns: CLOCK_MONOTONIC time when the last response is received
+ **/
+typedef void (*libwou_range_cb_fn)(void *ctx, int status, uint8_t *data, 
+                                   uint32_t len, uint64_t rx_time_ns);
+/**
+ * libwou_read_cb_fn - completion of wou_read_async()
+ * @status:     0 on success; 
+ *              -EIO if the response wouf is lost,
+ *              -ECANCELED if the read is discarded by wou_abort_now(),
+ *              -ECONNRESET if the connection is re-established
+ * @data:       response data; valid only during the callback
+ * @rx_time_ns: CLOCK_MONOTONIC time when the response is received from USB
+ **/
+typedef void (*libwou_read_cb_fn)(void *ctx, int status, const uint8_t *data, 
+                                  uint16_t dsize, uint64_t rx_time_ns);
 
 /**
  * rt_wou_cmd - issue a write command to realtime WOU-Frame buffer
@@ -56,12 +421,267 @@ void rt_wou_cmd (
  **/
 void rt_wou_flush (wou_param_t *w_param);
 
+/**
+ * wou_abort_now - send RT_ABORT to OR32_RT_CMD ahead of queued WOU-Frames
+ * @discard:    (1) also drop queued WOU-Frames which are not sent to USB yet
+ * @latency_ns: (optional) command-to-wire latency of the RT_ABORT frame
+ * return 0 on success, -1 if the RT_ABORT frame could not be written
+ **/
+int wou_abort_now (wou_param_t *w_param, int discard, uint32_t *latency_ns);
+
 /**
  * issue a write command to synchronized WOU-Frame buffer
  **/
 void wou_cmd (wou_param_t *w_param, const uint8_t func, const uint16_t wb_addr, 
              const uint16_t dsize, const uint8_t *data);
 
+/**
+ * wou_wr - write command without argument checking, for generated accessors
+ *          (see wb_regs.hpp); the caller guarantees (dsize <= MAX_DSIZE)
+ **/
+void wou_wr (wou_param_t *w_param, const uint16_t wb_addr, const uint16_t dsize, 
+             const uint8_t *data);
+
+/**
+ * wou_rd - read command without argument checking; the result shows up 
+ *          in wou_reg_ptr(wb_addr) later
+ **/
+void wou_rd (wou_param_t *w_param, const uint16_t wb_addr, const uint16_t dsize);
+
+/**
+ * wou_sync_* - push SYNC commands (refer to sync_cmd.h) into JCMD FIFO
+ *  consecutive SYNC commands are packed into JCMD_SYNC_CMD writes of up 
+ *  to 32 bytes, filling up WOU-Frames; they go out with wou_flush()
+ * wou_sync_cmd:        n pre-packed SYNC commands
+ * wou_sync_jnt:        SYNC_JNT, dir: (1)positive (0)negative, pos: 0 ~ 8191
+ * wou_sync_dout:       SYNC_DOUT of output pin id
+ * wou_sync_din:        SYNC_DIN of input pin id, type: WAIT_LOW ... WAIT_RISE
+ * wou_sync_vel:        SYNC_VEL, vel: velocity in mm/s, sync: (1)velocity sync'd
+ * wou_sync_data:       n bytes of SYNC_DATA (immediate data)
+ * wou_sync_mot_param:  SYNC_MOT_PARAM of the joint, with 32-bit immediate data
+ * wou_sync_mach_param: SYNC_MACH_PARAM, with 32-bit immediate data
+ * wou_sync_usb_cmd:    SYNC_USB_CMD of the type, with 32-bit immediate data
+ * wou_sync_eof:        SYNC_EOF
+ **/
+void wou_sync_cmd (wou_param_t *w_param, const uint16_t *cmds, int n);
+void wou_sync_jnt (wou_param_t *w_param, int dir, uint16_t pos);
+void wou_sync_dout (wou_param_t *w_param, uint8_t id, uint8_t val);
+void wou_sync_din (wou_param_t *w_param, uint8_t id, uint8_t type);
+void wou_sync_vel (wou_param_t *w_param, uint16_t vel, uint8_t sync);
+void wou_sync_data (wou_param_t *w_param, const uint8_t *data, int n);
+void wou_sync_mot_param (wou_param_t *w_param, uint8_t joint, uint16_t addr, 
+                         uint32_t val);
+void wou_sync_mach_param (wou_param_t *w_param, uint16_t addr, uint32_t val);
+void wou_sync_usb_cmd (wou_param_t *w_param, uint16_t type, uint32_t val);
+void wou_sync_eof (wou_param_t *w_param);
+
+#define WOU_MAX_JOINTS  12
+
+/**
+ * wou_jnt_enc_t - joint-delta encoder into SYNC_JNT commands
+ * @njoints:    number of joints, 1 ~ WOU_MAX_JOINTS
+ * @frac_bits:  fractional bits of the targets, (0) targets are in pulses
+ * @prev:       last commanded positions in pulses
+ * @residual:   (target - prev) in fixed-point, not commanded yet
+ * @pending:    rows of SYNC_JNT still needed to reach the last target
+ * @splits:     number of moves split beyond +/-8191 pulses
+ **/
+typedef struct {
+    int         njoints;
+    int         frac_bits;
+    int64_t     prev[WOU_MAX_JOINTS];
+    int64_t     residual[WOU_MAX_JOINTS];
+    int         pending;
+    uint32_t    splits;
+} wou_jnt_enc_t;
+
+/**
+ * wou_jnt_enc_init - start encoding from pos[] (in pulses, NULL for 0)
+ **/
+void wou_jnt_enc_init (wou_jnt_enc_t *enc, int njoints, int frac_bits,
+                       const int64_t *pos);
+
+/**
+ * wou_jnt_encode - encode the move to target[] into rows of njoints SYNC_JNT
+ *  a delta beyond +/-8191 pulses is spread over consecutive rows; at most
+ *  (max_cmds / njoints) rows are emitted, the rest is left in @pending
+ *  return number of SYNC commands written into cmds[]
+ **/
+int wou_jnt_encode (wou_jnt_enc_t *enc, const int64_t *target, uint16_t *cmds,
+                    int max_cmds);
+
+/**
+ * wou_sync_jnts - wou_jnt_encode() the whole move into the SYNC command stream
+ *  return number of SYNC_JNT rows (base periods) pushed
+ **/
+int wou_sync_jnts (wou_param_t *w_param, wou_jnt_enc_t *enc, const int64_t *target);
+
+/**
+ * wou_mot_param_set, wou_mach_param_set - update the host copy of a
+ *  motion parameter (MAX_VELOCITY ... of a joint) or a machine parameter;
+ *  nothing is sent until wou_params_commit(), unchanged values are not sent
+ *  return 0 on success, INVALID_DATA if joint or addr is out of range
+ **/
+int wou_mot_param_set (wou_param_t *w_param, uint8_t joint, uint16_t addr,
+                       uint32_t val);
+int wou_mach_param_set (wou_param_t *w_param, uint16_t addr, uint32_t val);
+
+/**
+ * wou_params_commit - upload changed parameters as one packed SYNC stream
+ *  motion parameters go first, then machine parameters in address order
+ *  (MACHINE_CTRL last); the WOU-Frames are sealed with wou_fence()
+ * @ticket: (optional) wou_fence() ticket of the upload
+ *  return number of parameters uploaded
+ **/
+int wou_params_commit (wou_param_t *w_param, wou_ticket_t *ticket);
+
+/**
+ * wou_params_invalidate - mark every parameter ever set to be uploaded
+ *  again, e.g. after the FPGA is reconfigured
+ **/
+void wou_params_invalidate (wou_param_t *w_param);
+
+/**
+ * wou_cmdv - issue n wou commands in one go
+ *  USB I/O is pumped once at most; blocks like wou_cmd() if WOUFS is full
+ *  return 0 on success,
+ *         INVALID_DATA if any of the ops is invalid; nothing is issued
+ **/
+int wou_cmdv (wou_param_t *w_param, const wou_op_t *ops, int n);
+
+/**
+ * wou_try_cmd - non-blocking wou_cmd()
+ * @occupancy: (optional) number of WOU-Frames waiting for ACK
+ * return 0 on success,
+ *        -EAGAIN if the WOU-Frame window is full,
+ *        INVALID_DATA if (dsize > MAX_DSIZE)
+ **/
+int wou_try_cmd (wou_param_t *w_param, const uint8_t func, const uint16_t wb_addr, 
+                 const uint16_t dsize, const uint8_t *data, int *occupancy);
+
+/**
+ * wou_cmd_timeout - wou_cmd() which waits at most timeout_us for 
+ *                   an empty WOU-Frame
+ * return 0 on success,
+ *        -ETIMEDOUT if the WOU-Frame window is still full,
+ *        INVALID_DATA if (dsize > MAX_DSIZE)
+ **/
+int wou_cmd_timeout (wou_param_t *w_param, const uint8_t func, const uint16_t wb_addr, 
+                     const uint16_t dsize, const uint8_t *data, uint32_t timeout_us);
+
+/**
+ * wou_throttle - statistics of producers throttled by the WOU-Frame window
+ **/
+void wou_throttle (wou_param_t *w_param, wou_throttle_t *stat);
+
+/**
+ * wou_wait_until - pump USB I/O until pred(ctx) returns non-zero
+ * @timeout_us: (0) check once; (UINT32_MAX) wait forever
+ *  spins for a short while, then sleeps until the next USB transfer completes
+ *  return value:
+ *   0:          the condition holds
+ *  -ETIMEDOUT:  the condition does not hold after timeout_us
+ **/
+int wou_wait_until (wou_param_t *w_param, libwou_pred_fn pred, void *ctx, 
+                    uint32_t timeout_us);
+
+/**
+ * wou_wait_reg - wou_wait_until ((wou register[wb_addr] & mask) == value)
+ **/
+int wou_wait_reg (wou_param_t *w_param, uint16_t wb_addr, uint8_t mask, 
+                  uint8_t value, uint32_t timeout_us);
+
+/**
+ * wou_fence - seal pending wou commands and return a ticket for them
+ *  all wou commands issued before wou_fence() are acknowledged 
+ *  by FPGA when the ticket is acknowledged
+ **/
+wou_ticket_t wou_fence (wou_param_t *w_param);
+
+/**
+ * wou_is_acked - check if FPGA acknowledged the ticket; no USB I/O involved
+ *  tickets issued before wou_connect() are reported as acknowledged;
+ *  they survive the fast reconnect after USB errors
+ **/
+int wou_is_acked (wou_param_t *w_param, wou_ticket_t ticket);
+
+/**
+ * wou_wait_acked - wait at most timeout_us for FPGA to acknowledge the ticket
+ * @timeout_us: (0) check once; (UINT32_MAX) wait forever
+ *  return value:
+ *   0:          the ticket is acknowledged
+ *  -ETIMEDOUT:  the ticket is not acknowledged after timeout_us
+ **/
+int wou_wait_acked (wou_param_t *w_param, wou_ticket_t ticket, uint32_t timeout_us);
+
+/**
+ * wou_read_async - issue a WB_RD_CMD and call cb(ctx, ...) with its response
+ *  the read goes out with the current WOU-Frame (see wou_flush() and 
+ *  wou_fence()); cb is called from wou_update(), wou_flush() or wou_wait_*()
+ *  return value:
+ *   0:             the read is queued
+ *   -EAGAIN:       too many pending reads
+ *   INVALID_DATA:  (dsize > MAX_DSIZE)
+ **/
+int wou_read_async (wou_param_t *w_param, uint16_t wb_addr, uint16_t dsize, 
+                    libwou_read_cb_fn cb, void *ctx);
+
+/**
+ * wou_write_range - write len bytes to wishbone registers [wb_addr, wb_addr+len)
+ *  packets are packed two per WOU-Frame and pipelined through the window
+ * @ticket:     (optional) wou_fence() ticket of the last WOU-Frame
+ *  return 0 on success, INVALID_DATA if the range exceeds WB_REG_SIZE
+ **/
+int wou_write_range (wou_param_t *w_param, uint16_t wb_addr, uint32_t len, 
+                     const uint8_t *src, wou_ticket_t *ticket);
+
+/**
+ * wou_read_range - read wishbone registers [wb_addr, wb_addr+len) into dst
+ *  cb(ctx, ...) is called once after all responses are received;
+ *  dst must stay valid until then
+ *  return 0 on success, INVALID_DATA if the range is empty or exceeds WB_REG_SIZE,
+ *         -ENOMEM if out of memory
+ **/
+int wou_read_range (wou_param_t *w_param, uint16_t wb_addr, uint32_t len, 
+                    uint8_t *dst, libwou_range_cb_fn cb, void *ctx);
+
+/**
+ * wou_tmpl_new - create a WOU-Frame template for recurring cycles
+ *  usage: wou_tmpl_cmd() ... wou_tmpl_seal() once; then every cycle
+ *         wou_tmpl_patch() the changed fields and wou_tmpl_send()
+ *  the CRC is updated from the XOR delta of the patched bytes
+ *  return NULL if out of memory
+ **/
+wou_tmpl_t *wou_tmpl_new (void);
+
+/**
+ * wou_tmpl_cmd - record a wou command in the template
+ * @field:  (optional) id of the WB_WR_CMD data for wou_tmpl_patch()
+ *  return 0 on success,
+ *         -ENOSPC if the command does not fit into the WOU-Frame,
+ *         INVALID_DATA for invalid func/dsize or a sealed template
+ **/
+int wou_tmpl_cmd (wou_tmpl_t *tmpl, const uint8_t func, const uint16_t wb_addr, 
+                  const uint16_t dsize, const uint8_t *data, int *field);
+
+/**
+ * wou_tmpl_seal - finish recording; call after wou_init()
+ **/
+int wou_tmpl_seal (wou_tmpl_t *tmpl);
+
+/**
+ * wou_tmpl_patch - replace the data of a recorded WB_WR_CMD
+ **/
+int wou_tmpl_patch (wou_tmpl_t *tmpl, int field, const uint8_t *data);
+
+/**
+ * wou_tmpl_send - send the template as the next WOU-Frame
+ *  blocks like wou_cmd() if there's no empty WOU-Frame
+ **/
+int wou_tmpl_send (wou_param_t *w_param, wou_tmpl_t *tmpl);
+
+void wou_tmpl_free (wou_tmpl_t *tmpl);
+
 /**
  * wou_update - update wou registers if it's appeared in USB RX BUF
  **/
@@ -89,8 +709,8 @@ const void *wou_reg_ptr (wou_param_t *w_param, uint32_t wou_addr);
 
 /* wou_flush -
  *  return value:
- *   0: There is still empty wou frame.
- *  -1: No empty wou frame.
+ *   0: The WOU-Frame is sealed.
+ *  -1: No empty wou frame; the WOU-Frame is kept for next wou_flush().
 */
 int wou_flush (wou_param_t *w_param);
 
@@ -103,19 +723,271 @@ void wou_init (wou_param_t *w_param, const char *device_type,
                int device_id, const char *bitfile);
 
 /* Establishes a wou connexion.
-   Returns 0 on success or -1 on failure. */
+   Returns once the USB link is up and the FPGA is programmed, without
+   waiting for the first ACK (see wou_connect_poll() for that).
+   Returns 0 on success or -1 on failure; failing to program the FPGA
+   is a failure too. */
 int wou_connect (wou_param_t *w_param);
 
+/**
+ * wou_connect_start - begin a non-blocking wou_connect()
+ * @binfile:    RISC image to load once connected (see wou_prog_risc_cached()),
+ *              NULL for none
+ *  return 0 on success, -EBUSY if a connect is in progress
+ **/
+int wou_connect_start (wou_param_t *w_param, const char *binfile);
+
+/**
+ * wou_connect_poll - advance the connect started by wou_connect_start()
+ *  every call runs at most one phase and returns instead of waiting for 
+ *  the FPGA; call it again from the event loop after *wait_us
+ * @wait_us:    (optional) time until the next call makes progress
+ *  return the current phase: WOU_CONN_DONE when connected, 
+ *         WOU_CONN_FAILED on error
+ **/
+int wou_connect_poll (wou_param_t *w_param, uint32_t *wait_us);
+
+/**
+ * wou_connect_stats - per phase time of the latest connect
+ **/
+void wou_connect_stats (wou_param_t *w_param, wou_conn_stats_t *stats);
+
+/**
+ * wou_snapshot_save - save the configuration written by the host:
+ *                     write-only registers (pulse/encoder types, max PWM,
+ *                     JCMD_CTRL, ...) and the wou_*_param_set() tables
+ *  return 0 on success, -errno on failure
+ **/
+int wou_snapshot_save (wou_param_t *w_param, const char *path);
+
+/**
+ * wou_set_snapshot_path - (non-NULL) wou_close() saves a snapshot to path
+ **/
+void wou_set_snapshot_path (wou_param_t *w_param, const char *path);
+
+/**
+ * wou_restore - bring a board back to the configuration of a snapshot 
+ *               in a few packed WOU-Frames; load the RISC image first
+ * @ticket:     (optional) acknowledged when the board is configured
+ *  return 0 on success, INVALID_DATA if the snapshot is of another 
+ *         libwou build, -errno on failure
+ **/
+int wou_restore (wou_param_t *w_param, const char *path, wou_ticket_t *ticket);
+
+/**
+ * wou_reconn_stats - statistics of the fast reconnects
+ *  USB transfer errors and hotplug events trigger a reconnect inside 
+ *  the library; unacknowledged woufs are resent from Sb afterward
+ **/
+void wou_reconn_stats (wou_param_t *w_param, wou_reconn_stats_t *stats);
+
 /* Closes a wou connection */
 void wou_close (wou_param_t *w_param);
 
 /* prog risc core */
 int wou_prog_risc(wou_param_t *w_param, const char *binfile);
 
+/**
+ * wou_fpga_stats - per phase time of the latest wou_connect()
+ **/
+void wou_fpga_stats (wou_param_t *w_param, wou_fpga_stats_t *stats);
+
+/**
+ * wou_set_hot_attach - (1, default) wou_connect() skips programming the 
+ *  FPGA if the bitfile is the last one programmed on this board (recorded 
+ *  in $LIBWOU_CACHE_DIR) and the design still responds; (0) always program
+ **/
+void wou_set_hot_attach (wou_param_t *w_param, int enable);
+
+/**
+ * wou_prog_risc_cached - wou_prog_risc() which skips the upload if the
+ *  same image (by content hash) was the last one programmed on this board
+ *  since the FPGA was configured; the running RISC is left untouched then
+ *  records are kept in $LIBWOU_CACHE_DIR (default /tmp)
+ *  return 0 if uploaded, 1 if skipped, -1 on error
+ **/
+int wou_prog_risc_cached(wou_param_t *w_param, const char *binfile);
+
+/**
+ * wou_prog_stats - statistics of the latest wou_prog_risc()
+ **/
+void wou_prog_stats (wou_param_t *w_param, wou_prog_stats_t *stats);
+
+/**
+ * wou_mbox_subscribe - queue mails of the given tags to a ring of its own
+ *  The RX parser copies each mail into the ring of every subscriber 
+ *  whose tags match, instead of running the consumer inside the parser.
+ *  One consumer thread per subscriber may drain while another thread 
+ *  pumps USB I/O. When the ring is full the mail is dropped and counted.
+ * @tags:   bitmap of WOU_MBOX_TAG(MT_*), or WOU_MBOX_ALL
+ * @depth:  ring size in mails, rounded up to a power of 2
+ *  return NULL if WOU_MBOX_MAX_SUBS are subscribed or out of memory
+ **/
+wou_mbox_sub_t *wou_mbox_subscribe (wou_param_t *w_param, uint32_t tags, uint32_t depth);
+
+/**
+ * wou_mbox_unsubscribe - remove and free a subscriber
+ *  not while another thread pumps USB I/O
+ **/
+void wou_mbox_unsubscribe (wou_param_t *w_param, wou_mbox_sub_t *sub);
+
+/**
+ * wou_mbox_drain - hand pending mails to fn(), oldest first
+ *  buf_head has the layout of libwou_mailbox_cb_fn and is valid during 
+ *  the call only; the slots are released at once after the batch
+ * @max:    the most mails to hand out, (<= 0) all pending ones
+ *  return the number of mails handed out
+ **/
+int wou_mbox_drain (wou_mbox_sub_t *sub, libwou_mail_fn fn, void *ctx, int max);
+
+/**
+ * wou_mbox_stats - counters of a subscriber
+ **/
+void wou_mbox_stats (const wou_mbox_sub_t *sub, wou_mbox_stats_t *stats);
+
+/**
+ * wou_log_open - log mails of the given tags to a columnar file
+ *  Each record is {rx_time_ns, tag, w0 .. w(nwords-1), regs}: the first
+ *  nwords payload words of the mail (0 past its end) and the value of
+ *  each register in wb_reg_map[] when the mail arrived. The RX parser
+ *  appends the records in memory; a thread of the log writes them out.
+ *  See wou_log.h for the file format and wou-log2csv to convert it.
+ * @tags:   bitmap of WOU_MBOX_TAG(MT_*)
+ *  return 0 on success, INVALID_DATA for a bad column set or if a log
+ *         is open already, -errno on failure
+ **/
+int wou_log_open (wou_param_t *w_param, const char *path, uint32_t tags,
+                  int nwords, const wou_log_reg_t *regs, int nregs);
+
+/**
+ * wou_log_close - write out the pending records and close the log
+ *  not while another thread pumps USB I/O; wou_close() closes it as well
+ *  return 0 on success, -errno if records were lost to a write error
+ **/
+int wou_log_close (wou_param_t *w_param);
+
+/**
+ * wou_log_stats - counters of the open log, zeros if none
+ **/
+void wou_log_stats (wou_param_t *w_param, wou_log_stats_t *stats);
+
+/**
+ * wou_clock_config - fit the base period tick of the FPGA (bp_tick of
+ *  MT_MOTION_STATUS and MT_TICK) against the time each mail is received
+ * @bp_ns:  nominal base period; it picks the least delayed mail of each
+ *          group of 16 ticks until the first fit, and is the reference
+ *          of drift_ppm
+ * @window: samples of the fit, 8 ~ WOU_CLOCK_MAX_WINDOW, of 16 ticks 
+ *          each; (0) off
+ *  return 0 on success, INVALID_DATA for a bad window, or a zero bp_ns
+ *         with the fit on
+ **/
+int wou_clock_config (wou_param_t *w_param, uint32_t bp_ns, uint32_t window);
+
+/**
+ * wou_clock_tick_time - CLOCK_MONOTONIC time of a (64-bit) tick
+ *  The time includes the shortest FPGA-to-host delay seen, i.e. it is
+ *  when the mail of the tick would be received on the quickest USB round.
+ *  return 0 on success, -EAGAIN until the fit is locked
+ **/
+int wou_clock_tick_time (wou_param_t *w_param, uint64_t tick, uint64_t *t_ns);
+
+/**
+ * wou_clock_next_send - when the servo thread should seal and send 
+ *  (wou_flush()) the commands for the next base period
+ *  *send_ns is margin_ns before the time of the first tick still at 
+ *  least margin_ns away; *tick (may be NULL) is that tick. margin_ns
+ *  covers the USB round and the slack wanted ahead of the FPGA.
+ *  return 0 on success, -EAGAIN until the fit is locked
+ **/
+int wou_clock_next_send (wou_param_t *w_param, uint32_t margin_ns,
+                         uint64_t *send_ns, uint64_t *tick);
+
+/**
+ * wou_clock_stats - base period, drift and jitter of the fit
+ **/
+void wou_clock_stats (wou_param_t *w_param, wou_clock_stats_t *stats);
+
+/**
+ * wou_sfifo_config - grant credits for SYNC commands from a host model
+ *  of SFIFO; SYNC commands are held back while SFIFO would overflow, 
+ *  instead of stalling the FPGA. The model starts with an empty SFIFO; 
+ *  configure it before the first SYNC command of the connection.
+ * @cfg:    NULL or (depth == 0) to turn the model off
+ * @cb:     (may be NULL) low water and underrun warnings
+ *  return 0 on success, INVALID_DATA for a bad level_size, -EBUSY while
+ *         reads of the level register are pending
+ **/
+int wou_sfifo_config (wou_param_t *w_param, const wou_sfifo_cfg_t *cfg,
+                      libwou_sfifo_cb_fn cb, void *ctx);
+
+/**
+ * wou_sfifo_credits - SYNC words which could be pushed now without waiting
+ **/
+uint32_t wou_sfifo_credits (wou_param_t *w_param);
+
+/**
+ * wou_sfifo_stats - counters and the level of the SFIFO model
+ **/
+void wou_sfifo_stats (wou_param_t *w_param, wou_sfifo_stats_t *stats);
+
+/**
+ * wou_rpc_call - send a request to the RISC firmware without waiting for
+ *  its reply; up to WOU_RPC_MAX requests are in flight at once
+ *  The SYNC_USB_CMD goes out with the next wou_update() or wou_flush().
+ *  Replies carry no request ID: a mail completes the oldest pending 
+ *  request it matches, the order the firmware serves them in. cb (may 
+ *  be NULL) is called from the thread pumping USB I/O.
+ *  return the request ID (> 0), -EAGAIN if WOU_RPC_MAX requests are
+ *         pending, INVALID_DATA for a bad reply_tag
+ **/
+int wou_rpc_call (wou_param_t *w_param, const wou_rpc_req_t *req,
+                  libwou_rpc_cb_fn cb, void *ctx);
+
+/**
+ * wou_rpc_status - -EINPROGRESS while the request is pending, then the
+ *  status it completed with, until its slot is reused (-ENOENT)
+ **/
+int wou_rpc_status (wou_param_t *w_param, int id);
+
+/**
+ * wou_rpc_wait - pump USB I/O until the request completes
+ *  return the status of the request, or -ETIMEDOUT if it is still
+ *         pending after timeout_us (UINT32_MAX: no limit)
+ **/
+int wou_rpc_wait (wou_param_t *w_param, int id, uint32_t timeout_us);
+
+/**
+ * wou_rpc_stats - counters and round-trip latency of the requests
+ **/
+void wou_rpc_stats (wou_param_t *w_param, wou_rpc_stats_t *stats);
+
+/**
+ * wou_mail_dispatch_init - a dispatch table without handlers
+ **/
+void wou_mail_dispatch_init (wou_mail_dispatch_t *d);
+
+/**
+ * wou_mail_on - handle mails of tag with fn
+ *  return 0 on success, INVALID_DATA if (tag >= WOU_MAIL_NR_TAGS)
+ **/
+int wou_mail_on (wou_mail_dispatch_t *d, uint16_t tag, libwou_mail_handler_fn fn, void *ctx);
+
+/**
+ * wou_mail_dispatch - hand a mail to the handler of its tag without copying
+ *  a libwou_mail_fn, e.g. wou_mbox_drain (sub, wou_mail_dispatch, &d, 0)
+ * @dispatch:   wou_mail_dispatch_t
+ **/
+void wou_mail_dispatch (void *dispatch, const uint8_t *buf_head, uint64_t rx_time_ns);
+
 /* set wou callback functions */
+/* the mailbox callback runs inside the RX parser, refer to wou_mbox_subscribe() */
 void wou_set_mbox_cb (wou_param_t *w_param, libwou_mailbox_cb_fn callback);
 void wou_set_crc_error_cb (wou_param_t *w_param, libwou_crc_error_cb_fn callback);
 void wou_set_rt_cmd_cb (wou_param_t *w_param, libwou_rt_cmd_cb_fn callback);
+/* called with bytes done of wou_prog_risc() */
+void wou_set_progress_cb (wou_param_t *w_param, libwou_progress_cb_fn callback,
+                          void *ctx);
 
 #ifdef __cplusplus
 }
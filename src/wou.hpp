@@ -0,0 +1,106 @@
+/*
+ * Copyright © 2009-2010 Yishin Li <ysli@araisrobo.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _WOU_HPP_
+#define _WOU_HPP_
+
+#include <stdint.h>
+#include <errno.h>
+#include <chrono>
+#include <future>
+#include <system_error>
+#include <vector>
+
+#include "wou.h"
+
+namespace wou {
+
+/**
+ * read_result - response of wou::read_async()
+ * @data:       response data
+ * @rx_time_ns: CLOCK_MONOTONIC time when the response is received from USB
+ **/
+struct read_result {
+    std::vector<uint8_t>    data;
+    uint64_t                rx_time_ns;
+};
+
+namespace detail {
+
+inline void read_done (void *ctx, int status, const uint8_t *data,
+                       uint16_t dsize, uint64_t rx_time_ns)
+{
+    std::promise<read_result> *p = static_cast<std::promise<read_result> *>(ctx);
+
+    if (status == 0) {
+        read_result r;
+        r.data.assign (data, data + dsize);
+        r.rx_time_ns = rx_time_ns;
+        p->set_value (std::move (r));
+    } else {
+        p->set_exception (std::make_exception_ptr (
+            std::system_error (-status, std::generic_category (), "wou_read_async")));
+    }
+    delete p;
+}
+
+template <typename T>
+int future_ready (void *ctx)
+{
+    std::future<T> *f = static_cast<std::future<T> *>(ctx);
+    return (f->wait_for (std::chrono::seconds (0)) == std::future_status::ready);
+}
+
+} // namespace detail
+
+/**
+ * read_async - wou_read_async() completing a std::future
+ *  the future turns ready only while USB I/O is pumped, see wou::wait()
+ **/
+inline std::future<read_result> read_async (wou_param_t *w_param,
+                                            uint16_t wb_addr, uint16_t dsize)
+{
+    std::promise<read_result> *p = new std::promise<read_result>;
+    std::future<read_result> f = p->get_future ();
+    int ret;
+
+    ret = wou_read_async (w_param, wb_addr, dsize, detail::read_done, p);
+    if (ret != 0) {
+        int err = (ret == INVALID_DATA) ? EINVAL : -ret;
+        p->set_exception (std::make_exception_ptr (
+            std::system_error (err, std::generic_category (), "wou_read_async")));
+        delete p;
+    }
+    return f;
+}
+
+/**
+ * wait - seal pending wou commands and pump USB I/O until f is ready
+ * @timeout_us: (UINT32_MAX) wait forever
+ *  return true if f is ready
+ **/
+template <typename T>
+inline bool wait (wou_param_t *w_param, std::future<T> &f,
+                  uint32_t timeout_us = UINT32_MAX)
+{
+    wou_fence (w_param);
+    return (wou_wait_until (w_param, detail::future_ready<T>, &f, timeout_us) == 0);
+}
+
+} // namespace wou
+
+#endif  /* _WOU_HPP_ */
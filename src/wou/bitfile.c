@@ -41,6 +41,8 @@ information, go to www.linuxcnc.org.
 #include <fcntl.h>
 #include <errno.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 // #include <linux/types.h>
 #include <asm/types.h>
 #include "bitfile.h"
@@ -87,6 +89,8 @@ struct bitfile *bitfile_new(void)
 	bf->chunks[n].body = NULL;
     }
     bf->num_chunks = 0;
+    bf->map = NULL;
+    bf->map_len = 0;
     return bf;
 }
 
@@ -99,9 +103,18 @@ void bitfile_free(struct bitfile *bf)
     }
 
     for ( n = 0 ; n < BITFILE_MAXCHUNKS ; n++ ) {
-	if ( bf->chunks[n].body != NULL ) {
-	    free(bf->chunks[n].body);
+	if ( bf->chunks[n].body == NULL ) {
+	    continue;
 	}
+	/* bodies of a mapped file live in the mapping */
+	if ( (bf->map != NULL) && (bf->chunks[n].body >= bf->map) &&
+	     (bf->chunks[n].body < bf->map + bf->map_len) ) {
+	    continue;
+	}
+	free(bf->chunks[n].body);
+    }
+    if ( bf->map != NULL ) {
+	munmap(bf->map, bf->map_len);
     }
     free(bf);
 }
@@ -226,6 +239,98 @@ cleanup0:
     return NULL;
 }
 
+struct bitfile *bitfile_map(const char *fname)
+{
+    struct bitfile *bf;
+    struct stat st;
+    unsigned char *p, *end;
+    int fd, len_len;
+
+    /* create the struct */
+    bf = bitfile_new();
+    if ( bf == NULL ) {
+	errmsg(__func__,"creating struct");
+	return NULL;
+    }
+    /* open and map the file */
+    fd = open(fname, O_RDONLY);
+    if ( fd < 0 ) {
+	errmsg(__func__,"opening file: %s", strerror(errno));
+	goto cleanup0;
+    }
+    if ( fstat(fd, &st) != 0 ) {
+	errmsg(__func__,"stat file: %s", strerror(errno));
+	goto cleanup1;
+    }
+    if ( st.st_size < BITFILE_HEADERLEN ) {
+	errmsg(__func__,"reading header: file too short");
+	goto cleanup1;
+    }
+    p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if ( p == MAP_FAILED ) {
+	errmsg(__func__,"mapping file: %s", strerror(errno));
+	goto cleanup1;
+    }
+    madvise(p, st.st_size, MADV_SEQUENTIAL);
+    bf->map = p;
+    bf->map_len = st.st_size;
+    end = p + st.st_size;
+    /* first BITFILE_HEADERLEN bytes are a header */
+    if ( memcmp(p, header, BITFILE_HEADERLEN) != 0 ) {
+	errmsg(__func__,"header mismatch, '%s' is not a bitfile?", fname);
+	goto cleanup1;
+    }
+    p += BITFILE_HEADERLEN;
+    /* walk the chunks */
+    while ( p < end ) {
+	struct bitfile_chunk *ch;
+
+	if ( bf->num_chunks == BITFILE_MAXCHUNKS ) {
+	    errmsg(__func__,"more than %d chunks", BITFILE_MAXCHUNKS);
+	    goto cleanup1;
+	}
+	ch = &(bf->chunks[bf->num_chunks]);
+	ch->tag = *p++;
+	len_len = (strchr(BITFILE_SMALLCHUNKS, ch->tag) != NULL) ? 2 : 4;
+	if ( (end - p) < len_len ) {
+	    errmsg(__func__,"reading chunk %d: truncated length", bf->num_chunks);
+	    goto cleanup1;
+	}
+	/* big-endian length */
+	if ( len_len == 4 ) {
+	    ch->len = (int)( ((__u32)(p[0]) << 24 ) | ((__u32)(p[1]) << 16 ) |
+			     ((__u32)(p[2]) << 8 ) | (__u32)(p[3]) );
+	} else {
+	    ch->len = (int)( ((__u32)(p[0]) << 8 ) | (__u32)(p[1]) );
+	}
+	p += len_len;
+	if ( (ch->len < 0) || ((end - p) < ch->len) ) {
+	    errmsg(__func__,"reading chunk %d: truncated content", bf->num_chunks);
+	    ch->body = NULL;
+	    goto cleanup1;
+	}
+	ch->body = p;
+	p += ch->len;
+	bf->num_chunks++;
+    }
+
+    // save the filename
+    bf->filename = strdup(fname);
+    if (bf->filename == NULL) {
+        errmsg(__func__, "out of memory\n");
+        goto cleanup1;
+    }
+
+    /* done */
+    close (fd);
+    return bf;
+cleanup1:
+    close(fd);
+cleanup0:
+    bitfile_free(bf);
+    return NULL;
+}
+
 static int write_chunk(int fd, struct bitfile_chunk *ch)
 {
     int len_len, rv;
@@ -80,6 +80,8 @@ struct bitfile {
     unsigned char header[BITFILE_HEADERLEN];
     int num_chunks;
     struct bitfile_chunk chunks[BITFILE_MAXCHUNKS];
+    unsigned char *map;		/* file mapping of bitfile_map(), or NULL */
+    size_t map_len;
 };
 
 /************************************************************************/
@@ -106,6 +108,14 @@ void bitfile_free(struct bitfile *bf);
 struct bitfile *bitfile_read(const char *fname);
 
 
+/* 'bitfile_map' is like 'bitfile_read', but maps the file read-only
+   instead of reading it.  The chunk bodies point into the mapping and
+   must not be modified; 'bitfile_free' unmaps it.
+   It returns a pointer to the new struct bitfile, or NULL on error.
+*/
+struct bitfile *bitfile_map(const char *fname);
+
+
 /* 'bitfile_write' writes the contents of a caller supplied struct bitfile
    to a specified file in standard bitfile format.  It returns zero on
    success, or -1 on failure.  It will write the standard xilinx 'a'
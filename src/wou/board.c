@@ -47,6 +47,7 @@ information, go to www.linuxcnc.org.
 
 // use SWIG with Tcl instead: #include <ncurses.h>
 
+#include <ctype.h>
 #include <errno.h>
 #include <stdarg.h>
 #include <inttypes.h> // for printf()
@@ -58,6 +59,8 @@ information, go to www.linuxcnc.org.
 #include <assert.h>
 #include <sys/io.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <sys/types.h>
 #include <time.h>
 #include <sys/param.h>  // for MIN() and MAX()
@@ -147,7 +150,8 @@ static int prev_ss;
 #define TX_TIMEOUT 19000000     // unit: nano-sec
 #define BUF_SIZE 80             // the buffer size for tx_str[] and rx_str[]
 
-static int m7i43u_program_fpga(struct board *board, struct bitfile_chunk *ch);
+static int m7i43u_reconfig (board_t* board);
+static int m7i43u_load_fpga (struct board *board, struct bitfile_chunk *ch);
 
 // 
 // this array describes all the boards we know how to program
@@ -158,7 +162,8 @@ struct board board_table[] = {
         .board_type = "7i43u\0",
         .chip_type = "3s400tq144\0",
         .io_type = IO_TYPE_USB,
-        .program_funct = m7i43u_program_fpga
+        .reconfig_funct = m7i43u_reconfig,
+        .load_funct = m7i43u_load_fpga
     }
 };
 
@@ -191,123 +196,197 @@ static uint8_t bit_reverse (uint8_t data)
     return swaptab[data];
 }
 
-struct bitfile *open_bitfile_or_die(const char *filename) 
-{
-    struct bitfile *bf;
-    int r;
+#define BYTES_PER_WORD 4
+#define RISC_PROG_STEP 4096     // bytes between progress callbacks
 
-    printf ( "Reading '%s'...\n", filename);
+typedef struct {
+    board_t         *board;
+    wou_ticket_t    ticket;
+} risc_ack_t;
 
-    bf = bitfile_read(filename);
-    if (bf == NULL) {
-	ERRP ("reading bitstream file '%s'\n", filename);
-	exit(EC_FILE);
-    }
+static int risc_acked_cond (void *ctx)
+{
+    const risc_ack_t *a = ctx;
+    return board_is_acked (a->board, a->ticket);
+}
 
-    r = bitfile_validate_xilinx_info(bf);
-    if (r != 0) {
-	ERRP ("not a valid Xilinx bitfile\n");
-	exit(EC_FILE);
-    }
-    bitfile_print_xilinx_info(bf);
+typedef struct {
+    board_t         *board;
+    uint32_t        mail_count;
+} risc_mail_t;
 
-    return bf;
+static int risc_mail_cond (void *ctx)
+{
+    const risc_mail_t *m = ctx;
+    return m->board->wou->mail_count != m->mail_count;
 }
-#define WORDS_PER_LINE 8
-#define BYTES_PER_WORD 4
 
-int board_risc_prog(struct board* board, const char* binfile)
+/**
+ * risc_alive - wait RISC_ALIVE_NS at most for a mail of the firmware
+ *  the OR32 SRAM has no read back over wishbone; a resident image that
+ *  runs keeps sending mails, one that does not is uploaded again
+ *  return 1 if a mail came in
+ **/
+static int risc_alive (board_t* board)
 {
-    int value;
-    uint8_t data[MAX_DSIZE];
-    FILE  *fd;
-    int c;
-    uint32_t image_size;
-
-    // Counters keeping track of what we've printed
-    uint32_t current_addr;
-    uint32_t byte_counter;
-    uint32_t word_counter;
-
-    DP ("begin:\n");
+    risc_mail_t     m;
 
-    // or32 disable
-    data[0] = 0x00;
-    wou_append (board, (const uint8_t) WB_WR_CMD, (const uint16_t)(JCMD_BASE | OR32_CTRL),
-    		(const uint16_t)1, data); //wou_cmd
+    m.board = board;
+    m.mail_count = board->wou->mail_count;
+    return board_wait_until (board, risc_mail_cond, &m, RISC_ALIVE_NS) == 0;
+}
 
-    while(wou_eof (board, TYP_WOUF) == -1); //wou_flush(&w_param);
+/**
+ * board_risc_prog - load an OR32 image
+ *  the image is mapped and sent as OR32_PROG writes, packed into 
+ *  WOU-Frames as MAX_PSIZE allows; frames are sealed only when they are
+ *  full, so the GBN window keeps filled up
+ * @cached: (1) skip the upload if the same image is resident and sends
+ *          mails, see cache.c
+ *  return 0 if uploaded, 1 if skipped, -1 on error
+ **/
+int board_risc_prog(struct board* board, const char* binfile, int cached)
+{
+    uint8_t         data[2*sizeof(uint32_t)];
+    const uint8_t   *image;
+    struct stat     st;
+    risc_ack_t      ack;
+    wou_ticket_t    start;
+    wou_prog_stats_t *stats;
+    uint64_t        t0;
+    uint64_t        hash;
+    uint32_t        image_size;
+    uint32_t        addr;
+    uint32_t        next_step;
+    int             fd;
 
+    DP ("begin:\n");
 
-    // begin: write OR32 iamge
-    fd = fopen(binfile, "r" );
-    if (fd == NULL) {
+    // begin: map OR32 iamge
+    fd = open (binfile, O_RDONLY);
+    if (fd < 0) {
 	ERRP ("%s: %s\n", binfile, strerror(errno));
 	ERRP ("reading RISC program file: %s\n", binfile);
         return -1;
     }
-    fseek(fd, 0, SEEK_END);
-    image_size = ftell(fd);
-    fseek(fd,0,SEEK_SET);
-
-    // Now we should have the size of the file in bytes.
+    if (fstat (fd, &st) != 0) {
+	ERRP ("%s: %s\n", binfile, strerror(errno));
+        close (fd);
+        return -1;
+    }
+    image_size = st.st_size;
     // Let's ensure it's a word(4-bytes) multiple
-    assert ((image_size%4) == 0);
-
-    // Now write out the image size
-    current_addr = 0;
-    byte_counter = 0;
-    word_counter = 0;
-    // Now write out the binary data to VMEM format: @ADDRESSS XXXXXXXX XXXXXXXX XXXXXXXX XXXXXXXX
-    while ((c = fgetc(fd)) != EOF) {
-        if (byte_counter == 0) {
-            memcpy (data+sizeof(uint32_t), &current_addr, sizeof(uint32_t));
-        }
-        current_addr++;
-        byte_counter++;
+    if ((image_size == 0) || ((image_size % BYTES_PER_WORD) != 0)) {
+	ERRP ("%s: image size (%u) is not a multiple of %d\n", 
+              binfile, image_size, BYTES_PER_WORD);
+        close (fd);
+        return -1;
+    }
+    image = mmap (NULL, image_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+    if (image == MAP_FAILED) {
+	ERRP ("%s: %s\n", binfile, strerror(errno));
+        return -1;
+    }
+    madvise ((void *) image, image_size, MADV_SEQUENTIAL);
+
+    stats = &(board->wou->prog_stats);
+    memset (stats, 0, sizeof(wou_prog_stats_t));
+    stats->bytes = image_size;
+    t0 = wou_time_ns ();
+
+    hash = wou_fnv1a (image, image_size);
+    if (cached && board_risc_cache_hit (board, hash, image_size) &&
+        risc_alive (board)) {
+        munmap ((void *) image, image_size);
+        stats->cached = 1;
+        stats->elapsed_ns = wou_time_ns () - t0;
+        DP ("%s(%016" PRIx64 ") is resident\n", binfile, hash);
+        return 1;
+    }
+    board_risc_cache_drop (board);
+
+    // or32 disable
+    data[0] = 0x00;
+    wou_append (board, (const uint8_t) WB_WR_CMD, (const uint16_t)(JCMD_BASE | OR32_CTRL),
+    		(const uint16_t)1, data); //wou_cmd
+    start = board_fence (board);
+
+    // one OR32_PROG per word: DATA(little-endian) followed by ADDR
+    next_step = RISC_PROG_STEP;
+    for (addr = 0; addr < image_size; addr += BYTES_PER_WORD) {
         // convert big-endian to little-endian
-        data[BYTES_PER_WORD - byte_counter] = (uint8_t) c;
-
-        if (byte_counter == BYTES_PER_WORD) {
-            word_counter++;
-            byte_counter=0;
-            // issue an OR32_PROG command
-            wou_append (board, (const uint8_t)WB_WR_CMD, (const uint16_t)(JCMD_BASE | OR32_PROG),
-            		(const uint16_t) 2*sizeof(uint32_t),  (const uint8_t*)data);//wou_cmd
-        }
-        if (word_counter == WORDS_PER_LINE) {
-                word_counter = 0;
-                while(wou_eof (board, TYP_WOUF) == -1);
-                DP ("current_addr(0x%08X)\n", current_addr);
+        data[0] = image[addr + 3];
+        data[1] = image[addr + 2];
+        data[2] = image[addr + 1];
+        data[3] = image[addr + 0];
+        memcpy (data+sizeof(uint32_t), &addr, sizeof(uint32_t));
+        wou_append (board, (const uint8_t)WB_WR_CMD, (const uint16_t)(JCMD_BASE | OR32_PROG),
+                    (const uint16_t) 2*sizeof(uint32_t),  (const uint8_t*)data);//wou_cmd
+        if ((addr + BYTES_PER_WORD) >= next_step) {
+            next_step += RISC_PROG_STEP;
+            if (board->wou->prog_callback) {
+                board->wou->prog_callback (board->wou->prog_ctx, 
+                                           addr + BYTES_PER_WORD, image_size);
+            }
         }
     }
-
-    if (word_counter != 0) {
-        // terminate pending WOU commands
-    	while(wou_eof (board, TYP_WOUF) == -1);
+    munmap ((void *) image, image_size);
+
+    // wait for the last image frame
+    ack.board = board;
+    ack.ticket = board_fence (board);
+    board_wait_until (board, risc_acked_cond, &ack, -1);
+    stats->frames = ((((uint64_t) ack.ticket.epoch << 8) | ack.ticket.tid) -
+                     (((uint64_t) start.epoch << 8) | start.tid));
+    stats->elapsed_ns = wou_time_ns () - t0;
+    if (stats->elapsed_ns) {
+        stats->bytes_per_sec = (uint64_t) image_size * 1000000000ULL / stats->elapsed_ns;
     }
+    if (board->wou->prog_callback && ((image_size % RISC_PROG_STEP) != 0)) {
+        board->wou->prog_callback (board->wou->prog_ctx, image_size, image_size);
+    }
+    DP ("%u bytes, %u frames, %" PRIu64 " ns, %u bytes/s\n", stats->bytes,
+        stats->frames, stats->elapsed_ns, stats->bytes_per_sec);
 
     // enable OR32 again
-    value = 0x01;
+    data[0] = 0x01;
     wou_append(board, (const uint8_t)WB_WR_CMD, (const uint16_t)(JCMD_BASE | OR32_CTRL),
-    		(const uint16_t)1, (const uint8_t*)&value); //wou_cmd
-    while(wou_eof (board, TYP_WOUF) == -1);
+    		(const uint16_t)1, (const uint8_t*)data); //wou_cmd
+    ack.ticket = board_fence (board);
+    board_wait_until (board, risc_acked_cond, &ack, -1);
+    board_risc_cache_store (board, hash, image_size);
 //end write OR32 image
     DP ("end:\n");
     return 0;
 }
 
-static int board_prog (struct board* board) 
+/**
+ * board_bitfile_open - map the bitfile and check it is for this board
+ *  return NULL on error
+ **/
+struct bitfile *board_bitfile_open (board_t* board)
 {
     struct bitfile *bf;
     char *bitfile_chip;
     struct bitfile_chunk *ch;
     int r;
 
-    // 
-    // open the bitfile
-    //
-    bf = open_bitfile_or_die(board->io.usb.bitfile);
+    printf ( "Reading '%s'...\n", board->io.usb.bitfile);
+
+    bf = bitfile_map(board->io.usb.bitfile);
+    if (bf == NULL) {
+	ERRP ("reading bitstream file '%s'\n", board->io.usb.bitfile);
+	return NULL;
+    }
+
+    r = bitfile_validate_xilinx_info(bf);
+    if (r != 0) {
+	ERRP ("not a valid Xilinx bitfile\n");
+        bitfile_free(bf);
+	return NULL;
+    }
+    bitfile_print_xilinx_info(bf);
 
     // chunk 'b' has the bitfile's target device, the chip type it's for
     ch = bitfile_find_chunk(bf, 'b', 0);
@@ -317,46 +396,83 @@ static int board_prog (struct board* board)
     // look up the device type that the caller requested in our table of
     // known device types
     // 
-    printf ("before strcasecmp(board->chip_type, bitfile_chip) \n");
-    printf ("debug: board(%p)\n", board);
-    printf("board_type(%s)\n", 
-            board->board_type);
-    printf("bitfile_chip(%s)\n", 
-           bitfile_chip);
-    printf("board->chip_type(%s), bitfile_chip(%s)\n", 
-           board->chip_type, bitfile_chip);
     if (strcasecmp(board->chip_type, bitfile_chip) != 0) {
         printf("ERROR: mismatch board->chip_type(%s), bitfile_chip(%s)\n", 
                board->chip_type, bitfile_chip);
-        return (-1);
+        bitfile_free(bf);
+        return NULL;
     }
-    
-    //
-    // program the board with the bitfile
-    //
+
     /* chunk 'e' has the bitstream */
-    printf ("before bitfile_find_chunk(bf, 'e', 0); \n");
-    ch = bitfile_find_chunk(bf, 'e', 0);
-    printf ("after bitfile_find_chunk(bf, 'e', 0); \n");
-
-    printf(
-        "Loading configuration %s into %s at USB-%x...\n",
-        bf->filename,
-        board->board_type,
-        board->io.usb.usb_devnum
-    );
-    r = board->program_funct(board, ch);
-    if (r != 0) {
-        ERRP ("configuration did not load");
-        return EC_HDW;
+    if (bitfile_find_chunk(bf, 'e', 0) == NULL) {
+        ERRP ("no bitstream in '%s'\n", board->io.usb.bitfile);
+        bitfile_free(bf);
+        return NULL;
+    }
+    return bf;
+}
+
+// init for GO_BACK_N
+/**
+ * tid_key - order woufs across TID wrap arounds
+ **/
+static uint64_t tid_key (uint32_t epoch, uint8_t tid)
+{
+    return (((uint64_t) epoch << 8) | tid);
+}
+
+/**
+ * rdq_pop_head - complete pending reads of woufs before @key with @status
+ **/
+static void rdq_pop_head (board_t* b, uint64_t key, int status)
+{
+    rdq_t   r;
+
+    while ((b->wou->rdq_head != b->wou->rdq_tail) && 
+           (b->wou->rdq[b->wou->rdq_head % NR_OF_RDQ].key < key)) {
+        r = b->wou->rdq[b->wou->rdq_head % NR_OF_RDQ];
+        b->wou->rdq_head ++;
+        r.cb (r.ctx, status, NULL, 0, b->wou->rx_time_ns);
     }
+}
 
-    bitfile_free(bf);
+/**
+ * rdq_pop_tail - complete pending reads of woufs since @key with @status
+ **/
+static void rdq_pop_tail (board_t* b, uint64_t key, int status)
+{
+    rdq_t   r;
 
-    return r;
+    while ((b->wou->rdq_head != b->wou->rdq_tail) && 
+           (b->wou->rdq[(b->wou->rdq_tail - 1) % NR_OF_RDQ].key >= key)) {
+        b->wou->rdq_tail --;
+        r = b->wou->rdq[b->wou->rdq_tail % NR_OF_RDQ];
+        r.cb (r.ctx, status, NULL, 0, b->wou->rx_time_ns);
+    }
+}
+
+/**
+ * rdq_match - complete the head read if @pkt is its response
+ * @key:    key of the wouf which @pkt responds to
+ * @pkt:    [WOU] packet of a response wouf
+ **/
+static void rdq_match (board_t* b, uint64_t key, const uint8_t *pkt)
+{
+    rdq_t       r;
+    uint16_t    wb_addr;
+
+    if (b->wou->rdq_head == b->wou->rdq_tail) {
+        return;
+    }
+    r = b->wou->rdq[b->wou->rdq_head % NR_OF_RDQ];
+    memcpy (&wb_addr, pkt+1, WB_ADDR_SIZE); 
+    if ((r.key != key) || (r.wb_addr != wb_addr) || (r.dsize != pkt[0])) {
+        return; // a response to wou_cmd(WB_RD_CMD)
+    }
+    b->wou->rdq_head ++;
+    r.cb (r.ctx, 0, pkt+WOU_HDR_SIZE, r.dsize, b->wou->rx_time_ns);
 }
 
-// init for GO_BACK_N
 static void gbn_init (board_t* board)
 {
     int i;
@@ -366,14 +482,21 @@ static void gbn_init (board_t* board)
     board->rd_dsize = 0;
     board->wr_dsize = 0;
     board->wou->tx_size = 0;
+    board->wou->tx_frag = 0;
     board->wou->rx_size = 0;
     board->wou->rx_state = SYNC;
+    // woufs of the old connection will never get responses
+    rdq_pop_tail (board, 0, -ECONNRESET);
     board->wou->tid = 0;
     board->wou->tidSb = 0;
+    // tickets issued before this point are taken as acknowledged
+    board->wou->tid_epoch = MAX(board->wou->tid_epoch, board->wou->ack_epoch) + 1;
+    board->wou->ack_epoch = board->wou->tid_epoch;
     board->wou->clock = 0;
     board->wou->Sn = 0;
     board->wou->Sb = 0;
     board->wou->Sm = NR_OF_WIN - 1;
+    board->wou->Sh = 0;
     for (i=0; i<NR_OF_CLK; i++) {
         board->wou->woufs[i].use = 0;
     }
@@ -395,6 +518,9 @@ int board_init (board_t* board, const char* device_type, const int device_id,
 #endif
 
     memset (board->wb_reg_map, 0, WB_REG_SIZE);
+    memset (board->shadow, 0, SHADOW_SIZE);
+    memset (board->shadow_valid, 0, SHADOW_SIZE);
+    board_shadow_init ();
     // memset (board->mbox_buf, 0, (WOUF_HDR_SIZE+MAX_PSIZE+CRC_SIZE));
 
     // look up the device type that the caller requested in our table of
@@ -409,9 +535,11 @@ int board_init (board_t* board, const char* device_type, const int device_id,
             board->board_type = board_table[i].board_type;
             board->chip_type = board_table[i].chip_type;
             board->io_type = board_table[i].io_type;
-            board->program_funct = board_table[i].program_funct;
+            board->reconfig_funct = board_table[i].reconfig_funct;
+            board->load_funct = board_table[i].load_funct;
             if (board->io_type == IO_TYPE_USB) {
                 board->io.usb.usb_devnum = device_id;
+                board->io.usb.usb_key[0] = '\0';
                 board->io.usb.bitfile = bitfile;
             }
             break;
@@ -429,9 +557,33 @@ int board_init (board_t* board, const char* device_type, const int device_id,
    
     board->wou = (wou_t *) malloc (sizeof(wou_t));
     board->wou->mbox_callback = NULL;
+    memset (board->wou->mbox_subs, 0, sizeof(board->wou->mbox_subs));
     board->wou->crc_error_callback = NULL;
     board->wou->rt_cmd_callback = NULL;
+    board->wou->prog_callback = NULL;
+    board->wou->prog_ctx = NULL;
+    memset (&(board->wou->prog_stats), 0, sizeof(wou_prog_stats_t));
+    memset (&(board->wou->fpga_stats), 0, sizeof(wou_fpga_stats_t));
+    board->wou->hot_attach = 1;
     board->wou->crc_error_counter = 0;
+    memset (&(board->wou->throttle), 0, sizeof(throttle_t));
+    board->wou->spin_ns = WAIT_SPIN_MIN_NS;
+    board->wou->tid_epoch = 0;
+    board->wou->ack_epoch = 0;
+    board->wou->rdq_head = 0;
+    board->wou->rdq_tail = 0;
+    board->wou->rx_time_ns = 0;
+    board->wou->mail_count = 0;
+    board->wou->sync_pkt = -1;
+    board->wou->params = NULL;
+    board->wou->snap_path = NULL;
+    board->wou->log = NULL;
+    memset (&(board->wou->rpc), 0, sizeof(rpc_t));
+    board->wou->rpc.next_deadline = UINT64_MAX;
+    memset (&(board->wou->sfifo), 0, sizeof(sfifo_t));
+    memset (&(board->wou->csync), 0, sizeof(csync_t));
+    memset (&(board->wou->conn), 0, sizeof(conn_t));
+    memset (&(board->wou->link), 0, sizeof(link_t));
     // for calculating TX_TIMEOUT:
     clock_gettime(CLOCK_REALTIME, &time_send_begin);
     gbn_init (board);
@@ -442,67 +594,358 @@ int board_init (board_t* board, const char* device_type, const int device_id,
     return 0;
 }
 
-int board_reconnect(board_t* board) {
-	int ret, cfg;
-	struct ftdi_context *ftdic;
-	uint8_t cBufWrite;
+/**
+ * usb_tc_cancel - cancel a pending async transfer and release it
+ **/
+static void usb_tc_cancel (struct ftdi_transfer_control **tc)
+{
+    if (*tc == NULL) {
+        return;
+    }
+    if ((*tc)->transfer && !(*tc)->completed) {
+        libusb_cancel_transfer ((*tc)->transfer);
+    }
+    ftdi_transfer_data_done (*tc);  // reaps the cancelled transfer
+    *tc = NULL;
+}
+
+/**
+ * link_lost - note a failed USB transfer; wou_send() and wou_recv() call
+ *             board_reconnect() before the next transfer
+ **/
+static void link_lost (board_t* b)
+{
+    link_t      *l;
+
+    l = &(b->wou->link);
+    if (l->lost) {
+        return;
+    }
+    ERRP ("USB link lost: %s\n", ftdi_get_error_string (&(b->io.usb.ftdic)));
+    l->lost = 1;
+    l->t_lost = wou_time_ns ();
+    l->t_retry = 0;
+}
+
+/**
+ * link_down - try board_reconnect() if the link is lost
+ *  return 1 if the link is still down
+ **/
+static int link_down (board_t* b)
+{
+    link_t      *l;
+
+    l = &(b->wou->link);
+    if (!l->lost) {
+        return 0;
+    }
+    if (wou_time_ns () < l->t_retry) {
+        return 1;
+    }
+    return (board_reconnect (b) != 0);
+}
+
+/**
+ * link_recovered - the first ACK after board_reconnect()
+ **/
+static void link_recovered (board_t* b)
+{
+    link_t      *l;
+
+    l = &(b->wou->link);
+    l->recovering = 0;
+    l->stats.recovery_ns = wou_time_ns () - l->t_lost;
+    if (l->stats.recovery_ns > l->stats.max_recovery_ns) {
+        l->stats.max_recovery_ns = l->stats.recovery_ns;
+    }
+    printf ("USB link recovered in %" PRIu64 " us\n", l->stats.recovery_ns / 1000);
+}
+
+#ifdef HAVE_LIBUSB_HOTPLUG
+static int LIBUSB_CALL usb_hotplug_cb (libusb_context *ctx, libusb_device *dev,
+                                       libusb_hotplug_event event, void *user_data)
+{
+    board_t     *b;
+    struct ftdi_context *ftdic;
+
+    (void) ctx;
+    b = (board_t *) user_data;
+    ftdic = &(b->io.usb.ftdic);
+    if (event == LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT) {
+        // another FTDI 0403:6001 may come and go
+        if ((ftdic->usb_dev == NULL) || (libusb_get_device (ftdic->usb_dev) != dev)) {
+            return 0;
+        }
+        b->wou->link.gone = 1;
+        link_lost (b);
+    } else if (b->wou->link.lost) {
+        b->wou->link.t_retry = 0;   // the device is back, reopen it now
+    }
+    return 0;
+}
+#endif  // HAVE_LIBUSB_HOTPLUG
+
+/**
+ * board_hotplug - get notified when the FTDI device leaves or arrives
+ **/
+static void board_hotplug (board_t* board, int enable)
+{
+#ifdef HAVE_LIBUSB_HOTPLUG
+    link_t      *l;
+    struct ftdi_context *ftdic;
+
+    l = &(board->wou->link);
     ftdic = &(board->io.usb.ftdic);
-    if ((ret = ftdi_usb_close(ftdic)) < 0)
-    {
-        ERRP("unable to close ftdi device: %d (%s)\n", ret, ftdi_get_error_string(ftdic));
-        return EXIT_FAILURE;
+    if (l->hotplug) {
+        libusb_hotplug_deregister_callback (ftdic->usb_ctx, l->hotplug_handle);
+        l->hotplug = 0;
     }
-    ftdi_deinit(ftdic);
-    if(board->io.usb.rx_tc) {
-    	free(board->io.usb.rx_tc);
+    if (enable && libusb_has_capability (LIBUSB_CAP_HAS_HOTPLUG)) {
+        l->hotplug = (libusb_hotplug_register_callback (
+                        ftdic->usb_ctx,
+                        LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT,
+                        0, 0x0403, 0x6001, LIBUSB_HOTPLUG_MATCH_ANY,
+                        usb_hotplug_cb, board, &(l->hotplug_handle)) == LIBUSB_SUCCESS);
     }
-    if(board->io.usb.tx_tc){
+#else
+    (void) board;
+    (void) enable;
+#endif  // HAVE_LIBUSB_HOTPLUG
+}
 
-    	free(board->io.usb.tx_tc);
+/**
+ * board_reconnect - recover from USB errors without losing the GBN window
+ *  Pending transfers are cancelled and the device is reopened only if it
+ *  stopped responding; the woufs in the GBN window and the register 
+ *  shadow are kept, and wou_send() resends from Sb.
+ *  return 0 on success, -1 to retry after RECONNECT_RETRY_NS
+ **/
+int board_reconnect (board_t* board)
+{
+    int         ret;
+    struct ftdi_context *ftdic;
+    link_t      *l;
+    uint64_t    now;
+
+    ftdic = &(board->io.usb.ftdic);
+    l = &(board->wou->link);
+    if (!l->lost) {
+        l->t_lost = wou_time_ns ();
     }
-	board->io.usb.rx_tc = NULL;    // init transfer_control for async-read
-	board->io.usb.tx_tc = NULL;    // init transfer_control for async-write
-	ftdic = &(board->io.usb.ftdic);
-	if (ftdi_init(ftdic) < 0)
-	{
-		ERRP("ftdi_init failed\n");
-		return EXIT_FAILURE;
-	}
-	ftdic->usb_read_timeout = 1000;
-	ftdic->usb_write_timeout = 1000;
-	ftdic->writebuffer_chunksize = TX_CHUNK_SIZE;
-	if (ret = ftdi_read_data_set_chunksize(ftdic, RX_CHUNK_SIZE) < 0) {
-		ERRP("ftdi_read_data_set_chunksize(): %d (%s)\n",
-			  ret, ftdi_get_error_string(ftdic));
-		return EXIT_FAILURE;
-	}
 
-	if ((ret = ftdi_usb_open(ftdic, 0x0403, 0x6001)) < 0)
-	{
-		ERRP("unable to open ftdi device: %d (%s)\n", ret, ftdi_get_error_string(ftdic));
-		return EXIT_FAILURE;
-	}
+    usb_tc_cancel (&(board->io.usb.rx_tc));
+    usb_tc_cancel (&(board->io.usb.tx_tc));
 
-	if ((ret = ftdi_set_latency_timer(ftdic, 1)) < 0)
-	{
-		ERRP("ftdi_set_latency_timer(): %d (%s)\n", ret, ftdi_get_error_string(ftdic));
-		return EXIT_FAILURE;
-	}
-	// RESET TX&RX Registers
-	if (board->io.usb.tx_tc) {
-		// finishing pending async write
-		ftdi_transfer_data_done (board->io.usb.tx_tc);
-		board->io.usb.tx_tc = NULL;
-	}
-	board->wou->tx_size = 0;
+    // fast path: the device is still there, a purge resyncs both FIFOs
+    if (l->gone || (ftdi_usb_purge_buffers (ftdic) < 0)) {
+        ftdi_usb_close (ftdic);
+        if (((ret = ftdi_usb_open (ftdic, 0x0403, 0x6001)) < 0) ||
+            ((ret = ftdi_set_latency_timer (ftdic, 1)) < 0) ||
+            ((ret = ftdi_usb_purge_buffers (ftdic)) < 0))
+        {
+            DP ("reopen ftdi device: %d (%s)\n", ret, ftdi_get_error_string(ftdic));
+            l->lost = 1;
+            l->t_retry = wou_time_ns () + RECONNECT_RETRY_NS;
+            l->stats.retries ++;
+            return -1;
+        }
+        l->stats.reopen ++;
+    }
+
+    // RESET TX&RX Registers
+    board->wou->tx_size = 0;
+    board->wou->tx_frag = 0;
+    board->wou->rx_size = 0;
+    board->wou->rx_state = SYNC;
+    board->wou->Sn = board->wou->Sb;
+    clock_gettime(CLOCK_REALTIME, &time_send_begin);
+
+    now = wou_time_ns ();
+    l->lost = 0;
+    l->gone = 0;
+    l->stats.count ++;
+    l->stats.link_ns = now - l->t_lost;
+    l->recovering = (tid_key (board->wou->tid_epoch, board->wou->tid) !=
+                     tid_key (board->wou->ack_epoch, board->wou->tidSb));
+    if (!l->recovering) {
+        link_recovered (board);
+    }
+    DP ("board_reconnect: Sn(%d) Sb(%d) Sm(%d)\n", 
+        board->wou->Sn, board->wou->Sb, board->wou->Sm);
+
+    return 0;
+}
+
+/**
+ * probe_frame - build an empty WOU_FRAME of wouf_cmd with TID 0
+ *  return size of the frame
+ **/
+static int probe_frame (uint8_t *buf, uint8_t wouf_cmd)
+{
+    wouf_t      f;
+    uint16_t    crc16;
+
+    wouf_clear (&f);
+    f.buf[3] = 0xFF & (f.fsize - WOUF_HDR_SIZE);
+    f.buf[4] = wouf_cmd;
+    f.buf[5] = 0;
+    f.buf[6] = 0xFF & (f.pload_size_rx);
+    crc16 = crcFast(f.buf + (WOUF_HDR_SIZE - 1), f.fsize - (WOUF_HDR_SIZE - 1));
+    memcpy (f.buf + f.fsize, &crc16, CRC_SIZE);
+    f.fsize += CRC_SIZE;
+    memcpy (buf, f.buf, f.fsize);
+    return f.fsize;
+}
+
+/**
+ * board_probe - check if a WOU design is running in the FPGA
+ *  send RST_TID and an empty TYP_WOUF, and wait PROBE_TIMEOUT_MS for
+ *  a response WOU_FRAME; an unconfigured FPGA does not respond
+ *  This only proves that some WOU design is alive, not which one: that
+ *  the design is the bitfile is up to the record of this very board,
+ *  see usb_key().
+ **/
+static int board_probe (board_t* board)
+{
+    struct ftdi_context *ftdic;
+    uint8_t     buf[2 * (WOUF_INIT_SIZE + CRC_SIZE)];
+    uint8_t     rx[RX_CHUNK_SIZE];
+    uint64_t    t0;
+    int         timeout;
+    int         alive;
+    int         len;
+    int         n;
+    int         i;
+
+    ftdic = &(board->io.usb.ftdic);
+    len = probe_frame (buf, RST_TID);
+    len += probe_frame (buf + len, TYP_WOUF);
+    if (ftdi_write_data (ftdic, buf, len) != len) {
+        ERRP("ftdi_write_data: (%s)\n", ftdi_get_error_string(ftdic));
+        return 0;
+    }
+
+    alive = 0;
+    timeout = ftdic->usb_read_timeout;
+    ftdic->usb_read_timeout = PROBE_TIMEOUT_MS;
+    t0 = wou_time_ns ();
+    while (!alive && ((wou_time_ns () - t0) < PROBE_TIMEOUT_MS * 1000000ULL)) {
+        n = ftdi_read_data (ftdic, rx, sizeof(rx));
+        if (n < 0) {
+            break;
+        }
+        for (i = 0; (i + 2) < n; i++) {
+            if ((rx[i] == WOUF_PREAMBLE) && (rx[i+1] == WOUF_PREAMBLE) && 
+                (rx[i+2] == WOUF_SOFD)) {
+                alive = 1;
+                break;
+            }
+        }
+    }
+    ftdic->usb_read_timeout = timeout;
+
+    if (alive) {
+        // the FPGA took TID 0; expect TID 0 again for gbn_init()
+        len = probe_frame (buf, RST_TID);
+        ftdi_write_data (ftdic, buf, len);
+    }
+    ftdi_usb_purge_buffers (ftdic);
+    return alive;
+}
+
+/**
+ * board_hot_attach - skip programming the FPGA if the bitfile is the last
+ *                    one programmed and the design is still running
+ **/
+int board_hot_attach (board_t* board)
+{
+    struct bitfile  *bf;
+    struct bitfile_chunk *ch;
+    uint64_t        fingerprint;
+    uint64_t        t0;
+    int             hit;
 
-	board->wou->Sn = board->wou->Sb;
-	DP("board_reconnect\n");
+    t0 = wou_time_ns ();
+    bf = bitfile_map (board->io.usb.bitfile);
+    if (bf == NULL) {
+        return 0;   // let board_bitfile_open() complain
+    }
+    ch = bitfile_find_chunk (bf, 'e', 0);
+    hit = 0;
+    if (ch) {
+        fingerprint = bitfile_fingerprint (bf);
+        hit = board_fpga_cache_hit (board, fingerprint, ch->len);
+        DP ("fingerprint(%016" PRIx64 ") hit(%d)\n", fingerprint, hit);
+    }
+    bitfile_free (bf);
+    board->wou->fpga_stats.map_ns = wou_time_ns () - t0;
+    if (!hit) {
+        return 0;
+    }
+
+    t0 = wou_time_ns ();
+    hit = board_probe (board);
+    board->wou->fpga_stats.probe_ns = wou_time_ns () - t0;
+    if (!hit) {
+        // the FPGA lost its configuration, e.g. power cycled
+        board_fpga_cache_drop (board);
+        board_risc_cache_drop (board);
+        return 0;
+    }
+    board->wou->fpga_stats.hot_attach = 1;
+    printf ("%s is running on %s at USB-%x, skip FPGA programming\n",
+            board->io.usb.bitfile, board->board_type, board->io.usb.usb_devnum);
+    return 1;
+}
 
-	return 0;
+/**
+ * usb_key - name the opened FTDI device for the records of cache.c
+ *  ftdi_usb_open() takes the first 0403:6001 it finds, so the key is the
+ *  serial number of the device, else its bus and port path
+ **/
+static void usb_key (board_t* board)
+{
+    struct libusb_device_descriptor desc;
+    libusb_device   *dev;
+    unsigned char   serial[32];
+    uint8_t         ports[7];
+    char            *key;
+    size_t          len;
+    int             n;
+    int             i;
+    int             j;
+
+    key = board->io.usb.usb_key;
+    len = sizeof(board->io.usb.usb_key);
+    key[0] = '\0';
+    dev = libusb_get_device (board->io.usb.ftdic.usb_dev);
+    if ((libusb_get_device_descriptor (dev, &desc) == 0) && desc.iSerialNumber &&
+        (libusb_get_string_descriptor_ascii (board->io.usb.ftdic.usb_dev,
+                desc.iSerialNumber, serial, sizeof(serial)) > 0)) {
+        for (i = 0; serial[i] && (i < (int) sizeof(serial) - 1); i++) {
+            if (!isalnum (serial[i])) {
+                serial[i] = '_';    // the key is part of a file name
+            }
+        }
+        serial[i] = '\0';
+        snprintf (key, len, "sn%s", serial);
+        return;
+    }
+    n = libusb_get_port_numbers (dev, ports, sizeof(ports));
+    if (n <= 0) {
+        return;
+    }
+    i = snprintf (key, len, "bus%d-%d", libusb_get_bus_number (dev), ports[0]);
+    for (j = 1; j < n; j++) {
+        i += snprintf (key + i, len - i, ".%d", ports[j]);
+    }
 }
 
-int board_connect (board_t* board)
+/**
+ * board_usb_open - open and reset the FTDI device
+ *  return 0 on success, -1 on failure
+ **/
+int board_usb_open (board_t* board)
 {
     int ret;
     struct ftdi_context *ftdic;
@@ -513,7 +956,7 @@ int board_connect (board_t* board)
     if (ftdi_init(ftdic) < 0)
     {
         ERRP("ftdi_init failed\n");
-        return EXIT_FAILURE;
+        return -1;
     }
     
     ftdic->usb_read_timeout = 1000;
@@ -522,32 +965,33 @@ int board_connect (board_t* board)
     if (ret = ftdi_read_data_set_chunksize(ftdic, RX_CHUNK_SIZE) < 0) {
         ERRP("ftdi_read_data_set_chunksize(): %d (%s)\n", 
               ret, ftdi_get_error_string(ftdic));
-        return EXIT_FAILURE;
+        return -1;
     }
     
     if ((ret = ftdi_usb_open(ftdic, 0x0403, 0x6001)) < 0)
     {
         ERRP("unable to open ftdi device: %d (%s)\n", ret, ftdi_get_error_string(ftdic));
-        return EXIT_FAILURE;
+        return -1;
     }
     
     if ((ret = ftdi_set_latency_timer(ftdic, 1)) < 0)
     {
         ERRP("ftdi_set_latency_timer(): %d (%s)\n", ret, ftdi_get_error_string(ftdic));
-        return EXIT_FAILURE;
+        return -1;
     }
 
     if ((ret = ftdi_usb_reset (ftdic)) < 0)
     {
         ERRP ("ftdi_usb_reset() failed: %d", ret);
-        return EXIT_FAILURE;
+        return -1;
     }
 
     if ((ret = ftdi_usb_purge_buffers (ftdic)) < 0)
     {
         ERRP ("ftdi_usb_purge_buffers() failed: %d", ret);
-        return EXIT_FAILURE;
+        return -1;
     }
+    usb_key (board);
 
     // Read out FTDIChip-ID of R type chips
     if (ftdic->type == TYPE_R)
@@ -557,24 +1001,38 @@ int board_connect (board_t* board)
         printf("FTDI chipid: %X\n", chipid);
     }
     
-    if (board->io.usb.bitfile) {
-        board_prog(board);  // program FPGA if bitfile is provided
-    }
-    
     DP ("ftdic->max_packet_size(%u)\n", ftdic->max_packet_size);
-    
+
+    board->wou->link.lost = 0;
+    board->wou->link.gone = 0;
+    board->wou->link.recovering = 0;
+    board->wou->link.hotplug = 0;   // registered to the previous usb_ctx
+    board_hotplug (board, 1);
+    return 0;
+}
+
+/**
+ * board_gbn_start - start GO-BACK-N over the opened USB connection
+ **/
+void board_gbn_start (board_t* board)
+{
     // for updating board_status:
     clock_gettime(CLOCK_REALTIME, &time_begin);
     clock_gettime(CLOCK_REALTIME, &time_send_begin);
     prev_ss = 0;
     
     gbn_init (board);   // go_back_n
-
-    return (0);
 }
 
 int board_close (board_t* board)
 {
+    int i;
+
+    board_log_close (board);
+    board_rpc_cancel (board);
+    if (board->wou->snap_path) {
+        board_snapshot_save (board, board->wou->snap_path);
+    }
 #ifdef HAVE_LIBFTD2XX
     if (board->io.usb.ftHandle) {
         FT_Close(board->io.usb.ftHandle);
@@ -585,6 +1043,7 @@ int board_close (board_t* board)
     int ret;
     struct ftdi_context *ftdic;
     ftdic = &(board->io.usb.ftdic);
+    board_hotplug (board, 0);
     if ((ret = ftdi_usb_close(ftdic)) < 0)
     {
         ERRP("unable to close ftdi device: %d (%s)\n", ret, ftdi_get_error_string(ftdic));
@@ -593,6 +1052,10 @@ int board_close (board_t* board)
     ftdi_deinit(ftdic);
 #endif  // HAVE_LIBFTDI
 #endif  // HAVE_LIBFTD2XX
+    free(board->wou->params);
+    for (i = 0; i < WOU_MBOX_MAX_SUBS; i++) {
+        board_mbox_unsubscribe (board, board->wou->mbox_subs[i]);
+    }
     free(board->wou);
     return 0;
 }   
@@ -630,39 +1093,98 @@ static int m7i43u_cpld_reset(struct board *board)
     return 1;
 }
 
-static int m7i43u_cpld_send_firmware(struct board *board, struct bitfile_chunk *ch) 
+/* reverse the bits of every byte in w */
+static inline uint64_t bit_reverse64 (uint64_t w)
 {
-    int i;
-    uint8_t *dp;
-    
-    dp = ch->body;
-    for (i = 0; i < ch->len; i ++) {
-        *dp = bit_reverse(*dp);
-        dp ++;
+    w = ((w >> 1) & 0x5555555555555555ULL) | ((w & 0x5555555555555555ULL) << 1);
+    w = ((w >> 2) & 0x3333333333333333ULL) | ((w & 0x3333333333333333ULL) << 2);
+    w = ((w >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((w & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    return w;
+}
+
+/**
+ * bit_reverse_copy - bit_reverse() from src to dst, 8 bytes at a time
+ **/
+static void bit_reverse_copy (uint8_t *dst, const uint8_t *src, int len)
+{
+    uint64_t    w;
+    int         i;
+
+    for (i = 0; (i + (int) sizeof(w)) <= len; i += sizeof(w)) {
+        memcpy (&w, src + i, sizeof(w));
+        w = bit_reverse64 (w);
+        memcpy (dst + i, &w, sizeof(w));
     }
+    for (; i < len; i ++) {
+        dst[i] = bit_reverse (src[i]);
+    }
+}
 
-    int ret;
+/**
+ * m7i43u_cpld_send_firmware - stream the bitstream to the CPLD
+ *  the bitstream is bit-reversed into a ring of NR_OF_BITQ buffers, and
+ *  the buffers are written as asynchronous bulk transfers; a buffer is 
+ *  refilled as soon as its transfer is done
+ **/
+static int m7i43u_cpld_send_firmware(struct board *board, struct bitfile_chunk *ch) 
+{
     struct ftdi_context     *ftdic;
-    
+    struct ftdi_transfer_control *tc[NR_OF_BITQ];
+    uint8_t     *ring;
+    int         sent;
+    int         head;
+    int         inflight;
+    int         slot;
+    int         len;
+    int         ret;
+    int         ok;
+
     ftdic = &(board->io.usb.ftdic);
+    ring = (uint8_t *) malloc (NR_OF_BITQ * BITQ_SIZE);
+    if (ring == NULL) {
+        ERRP("malloc: %s\n", strerror(errno));
+        return 0;
+    }
 
-    /* sync Write */
-    do {
-        if ((ret = ftdi_write_data (ftdic, ch->body, ch->len)) < 0)
-        {
-            ERRP("ftdi_write_data: %d (%s)\n", ret, ftdi_get_error_string(ftdic));
-        }
-        printf("ftdi_write %d bytes\n", ret);
-        if (ret) {
-            ch->len -= ret;
-            if (ch->len) {
-                memmove (ch->body, ch->body + ret, ch->len);
+    ok = 1;
+    sent = 0;
+    head = 0;
+    inflight = 0;
+    while (ok && ((sent < ch->len) || inflight)) {
+        if ((sent < ch->len) && (inflight < NR_OF_BITQ)) {
+            // the slot is free: its transfer is done
+            slot = head % NR_OF_BITQ;
+            len = MIN(BITQ_SIZE, ch->len - sent);
+            bit_reverse_copy (ring + slot * BITQ_SIZE, ch->body + sent, len);
+            tc[slot] = ftdi_write_data_submit (ftdic, ring + slot * BITQ_SIZE, len);
+            if (tc[slot] == NULL) {
+                ERRP("ftdi_write_data_submit: (%s)\n", ftdi_get_error_string(ftdic));
+                ok = 0;
+                break;
             }
+            sent += len;
+            head ++;
+            inflight ++;
+            continue;
         }
-    } while (ch->len != 0);
-
+        // wait for the oldest transfer
+        slot = (head - inflight) % NR_OF_BITQ;
+        ret = ftdi_transfer_data_done (tc[slot]);
+        inflight --;
+        if (ret < 0) {
+            ERRP("ftdi_transfer_data_done: %d (%s)\n", ret, ftdi_get_error_string(ftdic));
+            ok = 0;
+        }
+    }
+    while (inflight) {
+        slot = (head - inflight) % NR_OF_BITQ;
+        ftdi_transfer_data_done (tc[slot]);
+        inflight --;
+    }
+    free (ring);
+    printf("ftdi_write %d bytes\n", sent);
 
-    return 1;
+    return ok;
 }
 
 
@@ -680,6 +1202,49 @@ static struct timespec diff(struct timespec start, struct timespec end)
 }
 
 
+/**
+ * wou_time_ns - monotonic time stamp in nano-seconds for latency measurements
+ **/
+uint64_t wou_time_ns (void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return ((uint64_t) t.tv_sec * 1000000000ULL + t.tv_nsec);
+}
+
+/**
+ * gbn_dist - distance of clock index @i ahead of the sequence base (Sb)
+ **/
+static int gbn_dist (const wou_t *wou, int i)
+{
+    return ((i + NR_OF_CLK - wou->Sb) % NR_OF_CLK);
+}
+
+/**
+ * tx_consume - drop @n bytes which are written to USB from buf_tx[]
+ *              and keep tx_frag pointing to the end of the cut WOU_FRAME
+ **/
+static void tx_consume (board_t* b, int n)
+{
+    uint8_t *buf_tx;
+    int     pos;
+
+    buf_tx = b->wou->buf_tx;
+    assert (n <= b->wou->tx_size);
+
+    // walk over the WOU_FRAMEs: {PREAMBLE, PREAMBLE, SOFD, PLOAD_SIZE_TX, ... CRC}
+    pos = b->wou->tx_frag;
+    while (pos < n) {
+        pos += WOUF_HDR_SIZE + buf_tx[pos + 3] + CRC_SIZE;
+    }
+    b->wou->tx_frag = pos - n;
+
+    b->wr_dsize += n;
+    b->wou->tx_size -= n;
+    memmove(buf_tx, buf_tx + n, b->wou->tx_size);
+    return;
+}
+
 static uint8_t wb_reg_update (board_t* b, const uint8_t *buf)
 {
     uint8_t*    wb_regp;   // wb_reg_map pointer
@@ -723,6 +1288,7 @@ static int wouf_parse (board_t* b, const uint8_t *buf_head)
     uint8_t wou_dsize;
     uint8_t tidR;           // TID from FPGA
     uint8_t advance;        // Sb advance number (woufs to be flushed)
+    uint64_t resp_key;      // key of the wouf this response belongs to
     wouf_t  *wou_frame_;
     int     i;
     
@@ -762,7 +1328,16 @@ static int wouf_parse (board_t* b, const uint8_t *buf_head)
                                 advance, *Sm, *Sn, *Sb, b->wou->woufs[*Sn].use, b->wou->clock,tidR);
 #endif
             }
+            if (tidR < *tidSb) {
+                b->wou->ack_epoch ++;   // tidSb wraps around
+            }
             *tidSb = tidR;
+            resp_key = tid_key (b->wou->ack_epoch, tidR) - 1;
+            // responses of the skipped woufs are lost
+            rdq_pop_head (b, resp_key, -EIO);
+            if (b->wou->link.recovering) {
+                link_recovered (b);
+            }
             
         } else {
             // re-transmit wou_frames where Sb <= Sn <= Sm
@@ -797,6 +1372,7 @@ static int wouf_parse (board_t* b, const uint8_t *buf_head)
                 b->io.usb.tx_tc = NULL;
             }
             b->wou->tx_size = 0;
+            b->wou->tx_frag = 0;
             b->wou->rx_size = 0;
             // flushing RX buffer
             // // to clear tx and rx queue
@@ -826,10 +1402,12 @@ static int wouf_parse (board_t* b, const uint8_t *buf_head)
         buf_head += 3;          // point to [WOU]
         while (pload_size_tx > 0) {
             wou_dsize = wb_reg_update (b, buf_head);
+            rdq_match (b, resp_key, buf_head);
             pload_size_tx -= (WOU_HDR_SIZE + wou_dsize);
             assert ((pload_size_tx & 0x8000) == 0);   // no negative pload_size_tx
             buf_head += (WOU_HDR_SIZE + wou_dsize);
         }
+        rdq_pop_head (b, resp_key + 1, -EIO);
         DP ("TODO: return parsed pload_size_tx for assertion\n");
         return (0);
         // (buf_head[1] == TYP_WOUF)
@@ -846,6 +1424,20 @@ static int wouf_parse (board_t* b, const uint8_t *buf_head)
         //obsolete: for (i=0; i < (1 /* sizeof(PLOAD_SIZE_TX) */ + buf_head[0]); i++) {
         //obsolete:     b->mbox_buf[i] = buf_head[i];
         //obsolete: }
+        b->wou->mail_count ++;
+        if (b->wou->log) {
+            board_log_mail (b, buf_head);
+        }
+        if (b->wou->csync.window) {
+            board_clock_mail (b, buf_head);
+        }
+        if (b->wou->sfifo.cfg.depth) {
+            board_sfifo_mail (b, buf_head);
+        }
+        if (b->wou->rpc.pending_tags) {
+            board_rpc_mail (b, buf_head);
+        }
+        board_mbox_post (b, buf_head);
         if (b->wou->mbox_callback) {
             b->wou->mbox_callback(buf_head);
         }
@@ -888,6 +1480,12 @@ void wou_recv (board_t* b)
     rx_size = &(b->wou->rx_size);
     buf_rx = b->wou->buf_rx;
     rx_state = &(b->wou->rx_state);
+    if (b->wou->rpc.nr_pending) {
+        board_rpc_expire (b);
+    }
+    if (link_down (b)) {
+        return;
+    }
     if (b->io.usb.rx_tc) {
         // rx_tc->transfer could be NULL if (size <= ftdi->readbuffer_remaining)
         // at ftdi_read_data_submit();
@@ -906,9 +1504,12 @@ void wou_recv (board_t* b)
             if (recvd < 0) {
                 ERRP("recvd(%d) (%s)\n", recvd, ftdi_get_error_string(ftdic));
                 ERRP("readbuffer_remaining(%u)\n", ftdic->readbuffer_remaining);
-                recvd = 0;  // to issue another ftdi_read_data_submit()
+                b->io.usb.rx_tc = NULL;
+                link_lost (b);
+                return;
             } 
             b->io.usb.rx_tc = NULL;
+            b->wou->rx_time_ns = wou_time_ns();
 
         } else {
             return;
@@ -1094,19 +1695,14 @@ void wou_recv (board_t* b)
     {
         ERRP("ftdi_read_data_submit(): %s\n", ftdi_get_error_string (ftdic));
         ERRP("rx_size(%d)\n", *rx_size);
-
-        if(!strcmp(ftdi_get_error_string(ftdic),"cancel transfer failed (-5:libusb_error_not_found)")) {
-            if(board_reconnect(b) == 0 ) assert(0);
-        } else if(!strcmp(ftdi_get_error_string(ftdic),"invalid ftdi context OR invalid usb device")){
-            board_reconnect(b);
-        }
+        link_lost (b);
     }
 #endif
     return;
 } // wou_recv()
 
 
-static void wou_send (board_t* b)
+static void wou_send (board_t* b, int burst_min)
 {
 //    static struct timespec  time1 = {0, 0};
     struct timespec         time2, dt;
@@ -1122,6 +1718,9 @@ static void wou_send (board_t* b)
     struct ftdi_context     *ftdic;
     ftdic = &(b->io.usb.ftdic);
 
+    if (link_down (b)) {
+        return;
+    }
     clock_gettime(CLOCK_REALTIME, &time2);
     dt = diff(time_send_begin,time2);
     if (dt.tv_sec > 0 || dt.tv_nsec > TX_TIMEOUT) { 
@@ -1135,6 +1734,7 @@ static void wou_send (board_t* b)
             b->io.usb.tx_tc = NULL;
         }
         b->wou->tx_size = 0;
+        b->wou->tx_frag = 0;
         b->wou->Sn = b->wou->Sb;
         DP("TX TIMEOUT,Sm,Sn,Sb reconfig Sm(%d) Sn(%d) Sb(%d)\n", b->wou->Sm, b->wou->Sn, b->wou->Sb);
      }
@@ -1259,6 +1859,11 @@ static void wou_send (board_t* b)
         }
     }
        
+    // keep track of the first wouf which never went to buf_tx[]
+    if (gbn_dist (b->wou, *Sn) > gbn_dist (b->wou, b->wou->Sh)) {
+        b->wou->Sh = *Sn % NR_OF_CLK;
+    }
+
     if (*tx_size >= NR_OF_WIN*(WOUF_HDR_SIZE+2+MAX_PSIZE+CRC_SIZE)) {
         ERRP ("Sm(%d) Sn(%d) Sb(%d) Sn.use(%d) clock(%d)\n", 
               *Sm, *Sn, b->wou->Sb, b->wou->woufs[*Sn].use, b->wou->clock);
@@ -1280,7 +1885,9 @@ static void wou_send (board_t* b)
             dwBytesWritten = ftdi_transfer_data_done (b->io.usb.tx_tc);
             if (dwBytesWritten < 0) {
                 ERRP("dwBytesWritten(%d) (%s)\n", dwBytesWritten, ftdi_get_error_string(ftdic));
-                dwBytesWritten = 0;  // to issue another ftdi_write_data_submit()
+                b->io.usb.tx_tc = NULL;
+                link_lost (b);
+                return;
             } 
             b->io.usb.tx_tc = NULL;
         } else {
@@ -1299,13 +1906,10 @@ static void wou_send (board_t* b)
              *tx_size, dwBytesWritten, dwBytesWritten, dt.tv_sec, dt.tv_nsec);
         DP ("bitrate(%f Mbps)\n", 
              8.0*dwBytesWritten/(1000000.0*dt.tv_sec+dt.tv_nsec/1000.0));
-        assert (dwBytesWritten <= *tx_size);
-        b->wr_dsize += dwBytesWritten;
-        *tx_size -= dwBytesWritten;
-        memmove(buf_tx, buf_tx+dwBytesWritten, *tx_size);
+        tx_consume (b, dwBytesWritten);
     }
     
-    if (*tx_size < TX_BURST_MIN) {
+    if (*tx_size < burst_min) {
         DP ("skip wou_send(), tx_size(%d)\n", *tx_size);
         return;
     }
@@ -1340,8 +1944,8 @@ static void wou_send (board_t* b)
 
         ERRP("ftdi_write_data_submit(): %s\n", 
              ftdi_get_error_string (ftdic));
-
-      //  assert(0);
+        link_lost (b);
+        return;
 
     } else {
     	clock_gettime(CLOCK_REALTIME, &time_send_begin);
@@ -1382,6 +1986,10 @@ static void rt_wou_send (board_t* b)
 
     ftdic = &(b->io.usb.ftdic);
 
+    if (link_down (b)) {
+        return;     // rt_wouf is dropped as if buf_tx[] is full
+    }
+
     // there might be pended async write data
     tx_size = &(b->wou->tx_size);
     buf_tx = b->wou->buf_tx;
@@ -1414,7 +2022,9 @@ static void rt_wou_send (board_t* b)
             dwBytesWritten = ftdi_transfer_data_done (b->io.usb.tx_tc);
             if (dwBytesWritten < 0) {
                 ERRP("dwBytesWritten(%d) (%s)\n", dwBytesWritten, ftdi_get_error_string(ftdic));
-                dwBytesWritten = 0;  // to issue another ftdi_write_data_submit()
+                b->io.usb.tx_tc = NULL;
+                link_lost (b);
+                return;
             } 
             b->io.usb.tx_tc = NULL;
         } else {
@@ -1433,10 +2043,7 @@ static void rt_wou_send (board_t* b)
         //obsolete:      *tx_size, dwBytesWritten, dwBytesWritten, dt.tv_sec, dt.tv_nsec);
         //obsolete: DP ("bitrate(%f Mbps)\n", 
         //obsolete:      8.0*dwBytesWritten/(1000000.0*dt.tv_sec+dt.tv_nsec/1000.0));
-        assert (dwBytesWritten <= *tx_size);
-        b->wr_dsize += dwBytesWritten;
-        *tx_size -= dwBytesWritten;
-        memmove(buf_tx, buf_tx+dwBytesWritten, *tx_size);
+        tx_consume (b, dwBytesWritten);
     }
     
     if (*tx_size < TX_BURST_MIN) {
@@ -1453,94 +2060,315 @@ static void rt_wou_send (board_t* b)
 
         ERRP("ftdi_write_data_submit(): %s\n", 
              ftdi_get_error_string (ftdic));
+        link_lost (b);
     }/* else {
     	clock_gettime(CLOCK_REALTIME, &time_send_begin);
     }*/
     return;
 }
 
-int wou_eof (board_t* b, uint8_t wouf_cmd)
+/**
+ * wouf_has_room - check if the current wouf could be sealed
+ *                 NR_OF_RSV woufs ahead of the clock pointer are kept empty
+ **/
+static int wouf_has_room (board_t* b)
+{
+    return (b->wou->woufs[(b->wou->clock + NR_OF_RSV) % NR_OF_CLK].use == 0);
+}
+
+/**
+ * wouf_seal - seal the current wouf and move the clock pointer to next wouf
+ *  return value:
+ *   0: the wouf is sealed
+ *  -1: WOUFS is almost full; nothing is sealed
+ **/
+static void wouf_commit (board_t* b);
+
+static int wouf_seal (board_t* b, uint8_t wouf_cmd)
 {
     // took from vip/ftdi/generator.cpp::send_frame()
-    int         cur_clock;
     wouf_t      *wou_frame_;
     uint16_t    crc16;
-    int         next_5_clock;
-    wouf_t      *next_5_wouf_;
 
-    cur_clock = (int) b->wou->clock;
-    wou_frame_ = &(b->wou->woufs[cur_clock]);
+    if (!wouf_has_room (b)) {
+        return -1;  // WOUFS is almost full
+    }
+
+    wou_frame_ = &(b->wou->woufs[b->wou->clock]);
+    assert (wou_frame_->use == 0);  // currnt wouf must be empty to write to
+    assert ((wou_frame_->fsize - WOUF_HDR_SIZE) <= MAX_PSIZE);
+    // update PAYLOAD size TX/RX of WOU_FRAME 
+    // PLOAD_SIZE_TX is part of the header
+    wou_frame_->buf[3] = 0xFF & (wou_frame_->fsize - WOUF_HDR_SIZE);
+    wou_frame_->buf[4] = wouf_cmd;
+    wou_frame_->buf[5] = b->wou->tid;
+    wou_frame_->buf[6] = 0xFF & (wou_frame_->pload_size_rx);
+
+    assert(wou_frame_->buf[3] > 2); // PLOAD_SIZE_TX: 0x03 ~ 0xFF
+    assert(wou_frame_->buf[6] > 1); // PLOAD_SIZE_RX: 0x02 ~ 0xFF
     
-    next_5_clock = (int) (b->wou->clock + 5);
-    if (next_5_clock >= NR_OF_CLK) {
-        next_5_clock -= NR_OF_CLK;
-    }
-    next_5_wouf_ = &(b->wou->woufs[next_5_clock]);
-
-    if (next_5_wouf_->use == 0) { 
-        assert (wou_frame_->use == 0);  // currnt wouf must be empty to write to
-        assert ((wou_frame_->fsize - WOUF_HDR_SIZE) <= MAX_PSIZE);
-        // update PAYLOAD size TX/RX of WOU_FRAME 
-        // PLOAD_SIZE_TX is part of the header
-        wou_frame_->buf[3] = 0xFF & (wou_frame_->fsize - WOUF_HDR_SIZE);
-        wou_frame_->buf[4] = wouf_cmd;
-        wou_frame_->buf[5] = b->wou->tid;
-        wou_frame_->buf[6] = 0xFF & (wou_frame_->pload_size_rx);
-
-        assert(wou_frame_->buf[3] > 2); // PLOAD_SIZE_TX: 0x03 ~ 0xFF
-        assert(wou_frame_->buf[6] > 1); // PLOAD_SIZE_RX: 0x02 ~ 0xFF
-        
-        // calc CRC for {PLOAD_SIZE_TX, PLOAD_SIZE_RX, TID, WOU_PACKETS}
-        crc16 = crcFast(wou_frame_->buf + (WOUF_HDR_SIZE - 1), 
-                        wou_frame_->fsize - (WOUF_HDR_SIZE - 1)); 
-        memcpy (wou_frame_->buf + wou_frame_->fsize, &crc16, CRC_SIZE);
-        wou_frame_->fsize += CRC_SIZE;
-
-        // set use flag for CLOCK algorithm
-        wou_frame_->use = 1;    
-
-        // update the clock pointer
-        b->wou->clock += 1;
-        if (b->wou->clock == NR_OF_CLK) {
-            b->wou->clock = 0;  // clock: 0 ~ (NR_OF_CLK-1)
-        }
-        wou_frame_ = &(b->wou->woufs[b->wou->clock]);
+    // calc CRC for {PLOAD_SIZE_TX, PLOAD_SIZE_RX, TID, WOU_PACKETS}
+    crc16 = crcFast(wou_frame_->buf + (WOUF_HDR_SIZE - 1), 
+                    wou_frame_->fsize - (WOUF_HDR_SIZE - 1)); 
+    memcpy (wou_frame_->buf + wou_frame_->fsize, &crc16, CRC_SIZE);
+    wou_frame_->fsize += CRC_SIZE;
 
-        next_5_clock = (int) (b->wou->clock + 5);
-        if (next_5_clock >= NR_OF_CLK) {
-            next_5_clock -= NR_OF_CLK;
-        }
-        next_5_wouf_ = &(b->wou->woufs[next_5_clock]);
+    wouf_commit (b);
+    return 0;
+}
+
+/**
+ * wouf_commit - hand the current (sealed) wouf over to GBN and move on
+ **/
+static void wouf_commit (board_t* b)
+{
+    // set use flag for CLOCK algorithm
+    b->wou->woufs[b->wou->clock].use = 1;    
+
+    // update the clock pointer
+    b->wou->clock += 1;
+    if (b->wou->clock == NR_OF_CLK) {
+        b->wou->clock = 0;  // clock: 0 ~ (NR_OF_CLK-1)
     }
-    // flush pending [wou] packets
 
+    // init the wouf buffer and tid
+    b->wou->tid += 1;   // tid: 0 ~ 255
+    if (b->wou->tid == 0) {
+        b->wou->tid_epoch ++;
+    }
+    wouf_init (b);
+}
+
+/**
+ * wou_occupancy - number of sealed woufs which are not acknowledged yet
+ **/
+int wou_occupancy (board_t* b)
+{
+    return gbn_dist (b->wou, b->wou->clock);
+}
+
+int wou_eof (board_t* b, uint8_t wouf_cmd)
+{
+    int         ret;
+
+    ret = wouf_seal (b, wouf_cmd);
+    
+    // flush pending [wou] packets
     if (b->wou->rt_cmd_callback) {
         b->wou->rt_cmd_callback();
     }
-    wou_send(b);
+    wou_send(b, TX_BURST_MIN);
     wou_recv(b);    // update GBN pointer if receiving Rn
 
-    assert(wou_frame_->use == 0);   // wou protocol assume cur-wouf_ must be empty to write to
-    if (next_5_wouf_->use) {
-        // printf ("woufs almost full\n");
-        return -1;  // WOUFS is almost full
-    } else {
-        // init the wouf buffer and tid
-        b->wou->tid += 1;   // tid: 0 ~ 255
-        wouf_init (b);
-        return 0;
+    assert(b->wou->woufs[b->wou->clock].use == 0);   // wou protocol assume cur-wouf_ must be empty to write to
+    return (ret);
+}
+
+/**
+ * wou_block - sleep until any pending USB transfer completes or timeout_ns
+ **/
+static void wou_block (board_t* b, int64_t timeout_ns)
+{
+    struct ftdi_context *ftdic;
+    struct timeval      poll_timeout;
+
+    ftdic = &(b->io.usb.ftdic);
+    poll_timeout.tv_sec = timeout_ns / 1000000000;
+    poll_timeout.tv_usec = (timeout_ns % 1000000000) / 1000;
+    if (libusb_handle_events_timeout(ftdic->usb_ctx, &poll_timeout) < 0) {
+        ERRP("libusb_handle_events_timeout() (%s)\n", ftdi_get_error_string(ftdic));
     }
 }
 
-void wouf_init (board_t* b)
+/**
+ * board_wait_until - pump USB I/O until pred(ctx) returns non-zero
+ * @timeout_ns: (0) check once, (<0) wait forever
+ *  Pending woufs are written out even if (tx_size < TX_BURST_MIN).
+ *  Spin for wou->spin_ns first, then block on USB between polls.
+ *  spin_ns grows when the condition comes true while spinning, after
+ *  failing at least once, and shrinks when we end up sleeping anyway;
+ *  a condition which holds at once leaves it alone.
+ *  return value:
+ *   0:          the condition holds
+ *  -ETIMEDOUT:  the condition does not hold after timeout_ns
+ **/
+int board_wait_until (board_t* b, libwou_pred_fn pred, void *ctx, int64_t timeout_ns)
 {
-    // took from vip/ftdi/generator.cpp::init_frame()
-    int         cur_clock;
-    wouf_t      *wou_frame_;
+    uint64_t    t_begin;
+    uint64_t    dt;
+    int64_t     slice;
+    int         blocked;
+    int         spun;
+
+    t_begin = wou_time_ns();
+    blocked = 0;
+    spun = 0;
+    for (;;) {
+        // nothing else is coming; don't hold back a short burst
+        wou_send(b, 1);
+        wou_recv(b);
+        if (pred(ctx)) {
+            break;
+        }
+        dt = wou_time_ns() - t_begin;
+        if ((timeout_ns >= 0) && (dt >= (uint64_t) timeout_ns)) {
+            return -ETIMEDOUT;
+        }
+        if (dt < b->wou->spin_ns) {
+            spun = 1;
+            continue;
+        }
+        slice = WAIT_SLICE_NS;
+        if ((timeout_ns >= 0) && ((timeout_ns - (int64_t) dt) < slice)) {
+            slice = timeout_ns - dt;
+        }
+        wou_block (b, slice);
+        blocked = 1;
+    }
+
+    if (blocked) {
+        b->wou->spin_ns = MAX(b->wou->spin_ns / 2, WAIT_SPIN_MIN_NS);
+    } else if (spun) {
+        b->wou->spin_ns = MIN(b->wou->spin_ns * 2, WAIT_SPIN_MAX_NS);
+    }
+    return 0;
+}
+
+/**
+ * board_fence - seal the current wouf if it holds any wou packet
+ *  return the ticket of the last sealed wouf
+ **/
+wou_ticket_t board_fence (board_t* b)
+{
+    wou_ticket_t    ticket;
+
+    if (b->wou->woufs[b->wou->clock].fsize > WOUF_INIT_SIZE) {
+        wou_eof_wait (b, TYP_WOUF, -1);
+    }
+    ticket.tid = b->wou->tid - 1;
+    ticket.epoch = b->wou->tid_epoch;
+    if (b->wou->tid == 0) {
+        ticket.epoch --;
+    }
+    return ticket;
+}
+
+/**
+ * board_is_acked - the ticket is acknowledged if (tidSb > ticket.tid), 
+ *                  counting the wrap arounds
+ **/
+int board_is_acked (board_t* b, wou_ticket_t ticket)
+{
+    uint64_t    acked;
+    uint64_t    sealed;
+
+    acked = ((uint64_t) b->wou->ack_epoch << 8) | b->wou->tidSb;
+    sealed = ((uint64_t) ticket.epoch << 8) | ticket.tid;
+    return (acked > sealed);
+}
+
+/**
+ * board_read_async - append a WB_RD_CMD and queue it for rdq_match()
+ **/
+int board_read_async (board_t* b, uint16_t wb_addr, uint16_t dsize, 
+                      libwou_read_cb_fn cb, void *ctx)
+{
+    rdq_t   *r;
+    int     ret;
+
+    if ((b->wou->rdq_tail - b->wou->rdq_head) == NR_OF_RDQ) {
+        return -EAGAIN;
+    }
+    ret = wou_append_wait (b, WB_RD_CMD, wb_addr, dsize, NULL, -1);
+    if (ret != 0) {
+        return ret;
+    }
+
+    // the packet is in the current wouf, which is going to be sealed with tid
+    r = &(b->wou->rdq[b->wou->rdq_tail % NR_OF_RDQ]);
+    r->key = tid_key (b->wou->tid_epoch, b->wou->tid);
+    r->wb_addr = wb_addr;
+    r->dsize = dsize;
+    r->cb = cb;
+    r->ctx = ctx;
+    b->wou->rdq_tail ++;
+    return 0;
+}
+
+/**
+ * wouf_room_cond - board_wait_until() condition for wou_eof_wait()
+ **/
+static int wouf_room_cond (void *ctx)
+{
+    board_t *b = ctx;
+
+    // keep the realtime commands flowing while being throttled
+    if (b->wou->rt_cmd_callback) {
+        b->wou->rt_cmd_callback();
+    }
+    return wouf_has_room (b);
+}
+
+/**
+ * wouf_wait_room - wait for an empty wouf and account it to throttle stats
+ * @timeout_ns: (0) do not wait, (<0) wait forever
+ *  return 0, -EAGAIN or -ETIMEDOUT
+ **/
+static int wouf_wait_room (board_t* b, int64_t timeout_ns)
+{
+    uint64_t    t_begin;
+    uint64_t    dt;
+    int         ret;
+
+    if (timeout_ns == 0) {
+        b->wou->throttle.eagain ++;
+        return -EAGAIN;
+    }
+
+    // throttled: sleep on USB until GBN acknowledges some woufs
+    t_begin = wou_time_ns();
+    ret = board_wait_until (b, wouf_room_cond, b, timeout_ns);
+    dt = wou_time_ns() - t_begin;
+
+    b->wou->throttle.waits ++;
+    b->wou->throttle.wait_ns += dt;
+    if (dt > b->wou->throttle.wait_ns_max) {
+        b->wou->throttle.wait_ns_max = dt;
+    }
+    if (ret != 0) {
+        b->wou->throttle.timeouts ++;
+        return -ETIMEDOUT;
+    }
+    return 0;
+}
+
+/**
+ * wou_eof_wait - seal the current wouf; wait for an empty wouf if WOUFS is full
+ * @timeout_ns: (0) do not wait, (<0) wait forever
+ *  return value:
+ *   0:          the wouf is sealed
+ *  -EAGAIN:     WOUFS is full and (timeout_ns == 0)
+ *  -ETIMEDOUT:  WOUFS is still full after timeout_ns
+ **/
+int wou_eof_wait (board_t* b, uint8_t wouf_cmd, int64_t timeout_ns)
+{
+    int         ret;
 
-    cur_clock = (int) b->wou->clock;
-    wou_frame_ = &(b->wou->woufs[cur_clock]);
+    if (wou_eof (b, wouf_cmd) == 0) {
+        return 0;
+    }
+    if ((ret = wouf_wait_room (b, timeout_ns)) != 0) {
+        return ret;
+    }
+    return wou_eof (b, wouf_cmd);
+}
 
+/**
+ * wouf_clear - reset a wouf to an empty WOU_FRAME
+ **/
+void wouf_clear (wouf_t *wou_frame_)
+{
+    // took from vip/ftdi/generator.cpp::init_frame()
     wou_frame_->buf[0]          = WOUF_PREAMBLE;
     wou_frame_->buf[1]          = WOUF_PREAMBLE;
     wou_frame_->buf[2]          = WOUF_SOFD;    // Start of Frame Delimiter
@@ -1548,21 +2376,22 @@ void wouf_init (board_t* b)
     wou_frame_->buf[4]          = 0xFF;         // WOUF_COMMAND
     wou_frame_->buf[5]          = 0xFF;         // TID
     wou_frame_->buf[6]          = 0xFF;         // PLOAD_SIZE_RX
-    wou_frame_->fsize           = 7;
+    wou_frame_->fsize           = WOUF_INIT_SIZE;
     wou_frame_->pload_size_rx   = 2;            // there would be no PAYLOAD in response WOU_FRAME,
                                                 // in this case the response frame would be composed of {PLOAD_SIZE_TX, WOUF_COMMAND, TID/MAIL_TAG}
     wou_frame_->use             = 0;
+}
 
+void wouf_init (board_t* b)
+{
+    wouf_clear (&(b->wou->woufs[b->wou->clock]));
+    b->wou->sync_pkt = -1;
     return ;
 }
 
-void rt_wouf_init (board_t* b)
+static void rt_wouf_reset (wouf_t *wou_frame_)
 {
     // took from vip/ftdi/generator.cpp::rt_init_frame()
-    wouf_t      *wou_frame_;
-
-    wou_frame_ = &(b->wou->rt_wouf);
-
     wou_frame_->buf[0]          = WOUF_PREAMBLE;
     wou_frame_->buf[1]          = WOUF_PREAMBLE;
     wou_frame_->buf[2]          = WOUF_SOFD;    // Start of Frame Delimiter
@@ -1576,12 +2405,17 @@ void rt_wouf_init (board_t* b)
     return ;
 }
 
+void rt_wouf_init (board_t* b)
+{
+    rt_wouf_reset (&(b->wou->rt_wouf));
+    return ;
+}
+
 void rt_wou_append (
         board_t* b, const uint8_t func, const uint16_t wb_addr, 
         const uint16_t dsize, const uint8_t* buf)
 {
     wouf_t      *wou_frame_;
-    uint16_t    i;
 
     wou_frame_ = &(b->wou->rt_wouf);
 
@@ -1605,30 +2439,18 @@ void rt_wou_append (
         assert (0); // not a valid func
     }
 
-    // code took from vip/ftdi/generator.cpp:
-    i = wou_frame_->fsize;
-    wou_frame_->buf[i] = 0xFF & (func | (0x7F & dsize));
-    i++;
-    memcpy (wou_frame_->buf + i, &wb_addr, WB_ADDR_SIZE);
-    i+= WB_ADDR_SIZE;
-    if (func == WB_WR_CMD) {
-        memcpy (wou_frame_->buf + i, buf, dsize);
-        wou_frame_->fsize = i + dsize;
-    } else  if (func == WB_RD_CMD) {
-        wou_frame_->fsize = i;
-        wou_frame_->pload_size_rx += (WOU_HDR_SIZE + dsize);
-    }
+    wouf_put (wou_frame_, func, wb_addr, dsize, buf);
     return;    
 }   // rt_wou_append()
 
-int rt_wou_eof (board_t* b)
+/**
+ * rt_wouf_seal - fill in the header and CRC of a RT_WOUF
+ **/
+static void rt_wouf_seal (wouf_t *wou_frame_)
 {
     // took from vip/ftdi/generator.cpp::send_frame()
-    wouf_t      *wou_frame_;
     uint16_t    crc16;
 
-    wou_frame_ = &(b->wou->rt_wouf);
-
     assert ((wou_frame_->fsize - WOUF_HDR_SIZE) <= MAX_PSIZE);
     // update PAYLOAD size TX/RX of WOU_FRAME 
     // PLOAD_SIZE_TX is part of the header
@@ -1641,6 +2463,12 @@ int rt_wou_eof (board_t* b)
                     wou_frame_->fsize - (WOUF_HDR_SIZE - 1)); 
     memcpy (wou_frame_->buf + wou_frame_->fsize, &crc16, CRC_SIZE);
     wou_frame_->fsize += CRC_SIZE;
+    return;
+}
+
+int rt_wou_eof (board_t* b)
+{
+    rt_wouf_seal (&(b->wou->rt_wouf));
 
     /* rt_wouf 只有一個 WOU_FRAME, 不需要 check use bit */
     // wou_frame_->use = 1;    
@@ -1656,69 +2484,435 @@ int rt_wou_eof (board_t* b)
     return 0;
 } // rt_wou_eof()
 
-void wou_append (board_t* b, const uint8_t func, const uint16_t wb_addr, 
-                 const uint16_t dsize, const uint8_t* buf)
+/**
+ * tx_cancel - cancel the pending async write and return the number of
+ *             bytes which already went out to USB
+ **/
+static int tx_cancel (board_t* b)
 {
-    int         cur_clock;
-    wouf_t      *wou_frame_;
-    uint16_t    i;
+    struct ftdi_transfer_control    *tc;
+    struct ftdi_context             *ftdic;
+    struct timeval                  poll_timeout = {0, 1000};
+    uint64_t                        t_end;
+    int                             written;
+
+    tc = b->io.usb.tx_tc;
+    if (tc == NULL) {
+        return 0;
+    }
+    ftdic = &(b->io.usb.ftdic);
 
-    cur_clock = (int) b->wou->clock;
-    wou_frame_ = &(b->wou->woufs[cur_clock]);
+    if ((!tc->completed) && tc->transfer) {
+        libusb_cancel_transfer (tc->transfer);
+    }
+    t_end = wou_time_ns() + (uint64_t) ftdic->usb_write_timeout * 1000000ULL;
+    while ((!tc->completed) && (wou_time_ns() < t_end)) {
+        if (libusb_handle_events_timeout(ftdic->usb_ctx, &poll_timeout) < 0) {
+            ERRP("libusb_handle_events_timeout() (%s)\n", ftdi_get_error_string(ftdic));
+            break;
+        }
+    }
+    // tc->offset is lost after ftdi_transfer_data_done() for a cancelled transfer
+    written = tc->offset;
+    ftdi_transfer_data_done (tc);
+    b->io.usb.tx_tc = NULL;
 
-    // avoid exceeding WOUF_PAYLOAD limit
-    if (func == WB_WR_CMD) {
-        if ((wou_frame_->fsize - WOUF_HDR_SIZE + WOU_HDR_SIZE + dsize) 
-            > MAX_PSIZE) 
-        {
-            while(wou_eof (b, TYP_WOUF) == -1) {
-                printf("TODO: \n");
-                assert(0);
-            }
+    return (written);
+}
+
+/**
+ * board_abort_now - put RT_ABORT for OR32_RT_CMD at the head of next USB transfer
+ * @discard:    drop the sealed woufs which never went to buf_tx[]
+ * @latency_ns: time from calling till the abort frame was written to USB
+ **/
+int board_abort_now (board_t* b, int discard, uint32_t *latency_ns)
+{
+    struct ftdi_context *ftdic;
+    struct timeval      poll_timeout = {0, 1000};
+    wouf_t              abort_wouf;
+    uint32_t            rt_cmd;
+    uint64_t            t_begin;
+    uint64_t            t_end;
+    wou_t               *wou;
+    int                 written;
+    int                 n;
+    int                 i;
+
+    t_begin = wou_time_ns();
+    ftdic = &(b->io.usb.ftdic);
+    wou = b->wou;
+
+    // a minimal RT_WOUF with RT_ABORT only; keep pending rt_wouf untouched
+    rt_wouf_reset (&abort_wouf);
+    rt_cmd = RT_ABORT;
+    wouf_put (&abort_wouf, WB_WR_CMD, (JCMD_BASE | OR32_RT_CMD), 
+              sizeof(uint32_t), (const uint8_t *) &rt_cmd);
+    rt_wouf_seal (&abort_wouf);
+
+    // truncate pending bulk transfer
+    written = tx_cancel (b);
+    if (written) {
+        tx_consume (b, written);
+    }
+    
+    // keep the rest of a cut WOU_FRAME, otherwise FPGA would take 
+    // the abort frame as part of its payload
+    if (wou->tx_size > wou->tx_frag) {
+        wou->tx_size = wou->tx_frag;
+        wou->Sn = wou->Sb;  // GO-BACK-N: re-send truncated woufs later
+    }
+
+    if (discard) {
+        // drop sealed woufs [Sh, clock) and give their TIDs back
+        n = gbn_dist (wou, wou->clock) - gbn_dist (wou, wou->Sh);
+        for (i = 0; i < n; i++) {
+            wou->woufs[(wou->Sh + i) % NR_OF_CLK].use = 0;
         }
-    } else if (func == WB_RD_CMD) {
-        if (((wou_frame_->fsize - WOUF_HDR_SIZE + WOU_HDR_SIZE) > MAX_PSIZE) 
-            || 
-            ((wou_frame_->pload_size_rx + WOU_HDR_SIZE + dsize) > MAX_PSIZE))
-        {
-            while(wou_eof (b, TYP_WOUF) == -1) {
-                printf("TODO: \n");
-                assert(0);;
-            }
+        wou->clock = wou->Sh;
+        if (wou->tid < n) {
+            wou->tid_epoch --;  // give back TIDs across a wrap around
+        }
+        wou->tid -= n;
+        wouf_init (b);
+        rdq_pop_tail (b, tid_key (wou->tid_epoch, wou->tid), -ECANCELED);
+        DP ("discard %d woufs, clock(0x%02X) tid(0x%02X)\n", n, wou->clock, wou->tid);
+    }
+
+    memcpy (wou->buf_tx + wou->tx_size, abort_wouf.buf, abort_wouf.fsize);
+    wou->tx_size += abort_wouf.fsize;
+
+    // write it out now, regardless of TX_BURST_MIN
+    b->io.usb.tx_tc = ftdi_write_data_submit (ftdic, wou->buf_tx, 
+                                              MIN(wou->tx_size, TX_BURST_MAX));
+    if (b->io.usb.tx_tc == NULL) {
+        ERRP("ftdi_write_data_submit(): %s\n", ftdi_get_error_string (ftdic));
+        return -1;
+    }
+    clock_gettime(CLOCK_REALTIME, &time_send_begin);
+
+    t_end = t_begin + (uint64_t) ftdic->usb_write_timeout * 1000000ULL;
+    while ((!b->io.usb.tx_tc->completed) && (wou_time_ns() < t_end)) {
+        if (libusb_handle_events_timeout(ftdic->usb_ctx, &poll_timeout) < 0) {
+            ERRP("libusb_handle_events_timeout() (%s)\n", ftdi_get_error_string(ftdic));
+            break;
+        }
+    }
+    if (!b->io.usb.tx_tc->completed) {
+        ERRP ("RT_ABORT is not written in %d ms\n", ftdic->usb_write_timeout);
+        return -1;
+    }
+    if (latency_ns) {
+        *latency_ns = (uint32_t) MIN(wou_time_ns() - t_begin, UINT32_MAX);
+    }
+
+    written = ftdi_transfer_data_done (b->io.usb.tx_tc);
+    b->io.usb.tx_tc = NULL;
+    if (written < 0) {
+        ERRP("written(%d) (%s)\n", written, ftdi_get_error_string(ftdic));
+        return -1;
+    }
+    tx_consume (b, written);
+    DP ("RT_ABORT: %llu ns\n", (unsigned long long)(wou_time_ns() - t_begin));
+
+    return 0;
+}
+
+/**
+ * wou_append_wait - append a [WOU] packet to the current wouf
+ * @timeout_ns: time to wait for an empty wouf if the current one is full
+ *              (0) do not wait, (<0) wait forever
+ *  return value:
+ *   0 on success, -EAGAIN or -ETIMEDOUT if WOUFS is full
+ **/
+int wou_append_wait (board_t* b, const uint8_t func, const uint16_t wb_addr, 
+                     const uint16_t dsize, const uint8_t* buf, int64_t timeout_ns)
+{
+    int         ret;
+
+    if (!wouf_fits (&(b->wou->woufs[b->wou->clock]), func, dsize)) {
+        if ((ret = wou_eof_wait (b, TYP_WOUF, timeout_ns)) != 0) {
+            return ret;
         }
-    } else {
-        assert (0); // not a valid func
     }
 
-    cur_clock = (int) b->wou->clock;
-    wou_frame_ = &(b->wou->woufs[cur_clock]);
-        
     // DP ("func(0x%02X) dsize(0x%02X) wb_addr(0x%04X)\n", 
     //      func, dsize, wb_addr);
     
-    // code took from vip/ftdi/generator.cpp:
-    i = wou_frame_->fsize;
-    wou_frame_->buf[i] = 0xFF & (func | (0x7F & dsize));
-    i++;
-    memcpy (wou_frame_->buf + i, &wb_addr, WB_ADDR_SIZE);
-    i+= WB_ADDR_SIZE;
+    wouf_put (&(b->wou->woufs[b->wou->clock]), func, wb_addr, dsize, buf);
+    b->wou->sync_pkt = -1;
     if (func == WB_WR_CMD) {
-        // if (wb_addr == JCMD_SYNC_CMD) {
-        //     fprintf  ... debug SYNC_CMD only
-        // }
-        memcpy (wou_frame_->buf + i, buf, dsize);
-        wou_frame_->fsize = i + dsize;
-    } else  if (func == WB_RD_CMD) {
-        wou_frame_->fsize = i;
-        wou_frame_->pload_size_rx += (WOU_HDR_SIZE + dsize);
+        board_shadow_wr (b, wb_addr, dsize, buf);
     }
+    return 0;    
+}
+
+void wou_append (board_t* b, const uint8_t func, const uint16_t wb_addr, 
+                 const uint16_t dsize, const uint8_t* buf)
+{
+    // block until there's an empty wouf
+    wou_append_wait (b, func, wb_addr, dsize, buf, -1);
     return;    
 }
 
+typedef struct {
+    board_t     *b;
+    int         n;
+} room_cond_t;
+
+/**
+ * wouf_room_n_cond - board_wait_until() condition for sealing n woufs in a row
+ **/
+static int wouf_room_n_cond (void *ctx)
+{
+    const room_cond_t *c = ctx;
+
+    if (c->b->wou->rt_cmd_callback) {
+        c->b->wou->rt_cmd_callback();
+    }
+    return ((wou_occupancy (c->b) + c->n + NR_OF_RSV) <= NR_OF_CLK);
+}
+
+/**
+ * board_cmdv - append a batch of [WOU] packets
+ *  1st pass: validate all ops and find out where woufs are going to be sealed
+ *  2nd pass: place the packets; USB I/O is pumped once at the end
+ *  return value:
+ *   0 on success, 
+ *   INVALID_DATA if any op is invalid; nothing is appended in this case
+ **/
+int board_cmdv (board_t* b, const wou_op_t *ops, int n)
+{
+    wouf_t          *wou_frame_;
+    uint16_t        fsize;
+    uint16_t        pload_size_rx;
+    int             seals;
+    int             i;
+    room_cond_t     c;
+
+    wou_frame_ = &(b->wou->woufs[b->wou->clock]);
+    fsize = wou_frame_->fsize;
+    pload_size_rx = wou_frame_->pload_size_rx;
+    seals = 0;
+    for (i = 0; i < n; i++) {
+        if ((ops[i].dsize > MAX_DSIZE) || 
+            ((ops[i].func != WB_WR_CMD) && (ops[i].func != WB_RD_CMD))) {
+            ERRP ("ops[%d]: invalid func(0x%02X) or dsize(%d)\n", 
+                  i, ops[i].func, ops[i].dsize);
+            return INVALID_DATA;
+        }
+        if (!wouf_fits_size (fsize, pload_size_rx, ops[i].func, ops[i].dsize)) {
+            seals ++;
+            fsize = WOUF_INIT_SIZE;
+            pload_size_rx = 2;      // refer to wouf_init()
+        }
+        fsize += WOU_HDR_SIZE;
+        if (ops[i].func == WB_WR_CMD) {
+            fsize += ops[i].dsize;
+        } else {
+            pload_size_rx += WOU_HDR_SIZE + ops[i].dsize;
+        }
+    }
+
+    // wait once for all the woufs to be sealed
+    if (seals && ((wou_occupancy (b) + seals + NR_OF_RSV) > NR_OF_CLK)) {
+        c.b = b;
+        c.n = MIN(seals, NR_OF_CLK - NR_OF_RSV);
+        board_wait_until (b, wouf_room_n_cond, &c, -1);
+    }
+
+    for (i = 0; i < n; i++) {
+        if (!wouf_fits (wou_frame_, ops[i].func, ops[i].dsize)) {
+            if (wouf_seal (b, TYP_WOUF) != 0) {
+                // more than NR_OF_CLK woufs in one batch
+                wou_eof_wait (b, TYP_WOUF, -1);
+            }
+            wou_frame_ = &(b->wou->woufs[b->wou->clock]);
+        }
+        wouf_put (wou_frame_, ops[i].func, ops[i].wb_addr, ops[i].dsize, 
+                  ops[i].data);
+        b->wou->sync_pkt = -1;
+        if (ops[i].func == WB_WR_CMD) {
+            board_shadow_wr (b, ops[i].wb_addr, ops[i].dsize, ops[i].data);
+        }
+    }
+
+    if (seals) {
+        if (b->wou->rt_cmd_callback) {
+            b->wou->rt_cmd_callback();
+        }
+        wou_send(b, TX_BURST_MIN);
+        wou_recv(b);
+    }
+    return 0;
+}
+
+/**
+ * board_tmpl_send - send a sealed wouf template as the next wouf
+ * @timeout_ns: time to wait for an empty wouf, (0) do not wait, (<0) wait forever
+ *  return 0, INVALID_DATA if the template is not sealed, -EAGAIN or -ETIMEDOUT
+ **/
+int board_tmpl_send (board_t* b, struct wouf_tmpl *t, int64_t timeout_ns)
+{
+    int         ret;
+
+    if (!t->sealed) {
+        return INVALID_DATA;
+    }
+
+    // keep the order of pending wou packets
+    if (b->wou->woufs[b->wou->clock].fsize > WOUF_INIT_SIZE) {
+        if ((ret = wou_eof_wait (b, TYP_WOUF, timeout_ns)) != 0) {
+            return ret;
+        }
+    }
+    if (!wouf_has_room (b)) {
+        if ((ret = wouf_wait_room (b, timeout_ns)) != 0) {
+            return ret;
+        }
+    }
+
+    wouf_tmpl_tid (t, b->wou->tid);
+    b->wou->woufs[b->wou->clock] = t->wouf;
+    wouf_commit (b);
+
+    if (b->wou->rt_cmd_callback) {
+        b->wou->rt_cmd_callback();
+    }
+    wou_send(b, TX_BURST_MIN);
+    wou_recv(b);
+    return 0;
+}
+
+/**
+ * board_write_range - write a register range in RANGE_CHUNK packets
+ **/
+int board_write_range (board_t* b, uint16_t wb_addr, uint32_t len, 
+                       const uint8_t *src, wou_ticket_t *ticket)
+{
+    wou_op_t    ops[RANGE_BATCH];
+    uint32_t    offset;
+    int         n;
+    int         ret;
+
+    if ((wb_addr + len) > WB_REG_SIZE) {
+        ERRP ("range(0x%04X + %u) exceeds WB_REG_SIZE\n", wb_addr, len);
+        return INVALID_DATA;
+    }
+
+    offset = 0;
+    while (offset < len) {
+        for (n = 0; (n < RANGE_BATCH) && (offset < len); n++) {
+            ops[n].func = WB_WR_CMD;
+            ops[n].wb_addr = wb_addr + offset;
+            ops[n].dsize = MIN(len - offset, RANGE_CHUNK);
+            ops[n].data = src + offset;
+            offset += ops[n].dsize;
+        }
+        if ((ret = board_cmdv (b, ops, n)) != 0) {
+            return ret;
+        }
+    }
+
+    if (ticket) {
+        *ticket = board_fence (b);
+    } else {
+        board_fence (b);
+    }
+    return 0;
+}
+
+/**
+ * range_t - gather the RANGE_CHUNK reads of a board_read_range()
+ *           responses come in order, so offset tells where the next one
+ *           goes; failed reads may complete out of order (and without
+ *           data), so nothing is copied after the first failure
+ **/
+typedef struct {
+    uint8_t             *data;
+    uint32_t            len;
+    uint32_t            offset;
+    uint32_t            pending;
+    int                 status;
+    libwou_range_cb_fn  cb;
+    void                *ctx;
+} range_t;
+
+static void range_chunk_done (void *ctx, int status, const uint8_t *data, 
+                              uint16_t dsize, uint64_t rx_time_ns)
+{
+    range_t     *r = ctx;
+
+    if ((status == 0) && (r->status == 0)) {
+        if (dsize > (r->len - r->offset)) {
+            r->status = INVALID_DATA;
+        } else {
+            memcpy (r->data + r->offset, data, dsize);
+            r->offset += dsize;
+        }
+    } else if (r->status == 0) {
+        r->status = status;
+    }
+    r->pending --;
+    if (r->pending == 0) {
+        r->cb (r->ctx, r->status, r->data, r->len, rx_time_ns);
+        free (r);
+    }
+}
+
+static int rdq_has_room (void *ctx)
+{
+    board_t *b = ctx;
+    return ((b->wou->rdq_tail - b->wou->rdq_head) < NR_OF_RDQ);
+}
+
+/**
+ * board_read_range - read a register range in RANGE_CHUNK packets
+ **/
+int board_read_range (board_t* b, uint16_t wb_addr, uint32_t len, 
+                      uint8_t *dst, libwou_range_cb_fn cb, void *ctx)
+{
+    range_t     *r;
+    uint32_t    offset;
+    uint16_t    dsize;
+
+    if ((len == 0) || ((wb_addr + len) > WB_REG_SIZE)) {
+        ERRP ("invalid range(0x%04X + %u)\n", wb_addr, len);
+        return INVALID_DATA;
+    }
+
+    r = (range_t *) malloc (sizeof(range_t));
+    if (r == NULL) {
+        return -ENOMEM;
+    }
+    r->data = dst;
+    r->len = len;
+    r->offset = 0;
+    r->pending = (len + RANGE_CHUNK - 1) / RANGE_CHUNK;
+    r->status = 0;
+    r->cb = cb;
+    r->ctx = ctx;
+
+    for (offset = 0; offset < len; offset += dsize) {
+        dsize = MIN(len - offset, RANGE_CHUNK);
+        while (board_read_async (b, wb_addr + offset, dsize, 
+                                 range_chunk_done, r) == -EAGAIN) {
+            // too many reads in flight; let the responses drain
+            board_fence (b);
+            board_wait_until (b, rdq_has_room, b, -1);
+        }
+    }
+
+    board_fence (b);
+    return 0;
+}
+
 
-static void m7i43u_reconfig (board_t* board)
+/**
+ * m7i43u_reconfig - park 7i43u in RECONFIG mode
+ *  return ms to wait before m7i43u_load_fpga(), -1 on error
+ **/
+static int m7i43u_reconfig (board_t* board)
 {
-    struct timespec  time1, time2, dt;
     uint8_t cBufWrite;
     int     i;
     int ret;
@@ -1736,7 +2930,7 @@ static void m7i43u_reconfig (board_t* board)
     if ((ret = ftdi_usb_purge_buffers (ftdic)) < 0)
     {
         ERRP ("ftdi_usb_purge_buffers() failed: %d", ret);
-        return;
+        return -1;
     }
     // to flush rx queue
     while (ret = ftdi_read_data (ftdic, &cBufWrite, 1) > 0) { 
@@ -1756,7 +2950,7 @@ static void m7i43u_reconfig (board_t* board)
         // // use WOUF_COMMAND to reset Expected TID in FPGA
         // bypass TX_TIMEOUT:
         clock_gettime(CLOCK_REALTIME, &time_send_begin);
-        while(wou_eof (board, RST_TID) == -1);
+        wou_eof_wait (board, RST_TID, -1);
         board->wou->tid = 0;
     }
     
@@ -1765,7 +2959,7 @@ static void m7i43u_reconfig (board_t* board)
     wou_append (board, WB_WR_CMD, GPIO_BASE + GPIO_SYSTEM, 1, &cBufWrite);
     // bypass TX_TIMEOUT:
     clock_gettime(CLOCK_REALTIME, &time_send_begin);
-    while(wou_eof (board, TYP_WOUF) == -1);
+    wou_eof_wait (board, TYP_WOUF, -1);
     DP("tx_size(%d)\n", board->wou->tx_size);
 
 #if(TRACE)
@@ -1780,30 +2974,25 @@ static void m7i43u_reconfig (board_t* board)
         != board->wou->tx_size)
     {
         ERRP("ftdi_write_data: %d (%s)\n", ret, ftdi_get_error_string(ftdic));
-        return;
+        return -1;
     }
     
     printf("tx_size(%d)\n", board->wou->tx_size);
     // the delay is mandatory:
-    time2.tv_sec = 0;
-    time2.tv_nsec = 100000000;   // 100ms
-    nanosleep(&time2, NULL);
-    // DP ("rd_dsize(%lu)\n", board->rd_dsize);
-    printf ("rd_dsize(%llu), rx_tc(%p)\n", board->rd_dsize, board->io.usb.rx_tc);
-    // if (board->rd_dsize > 0) {
-    //     DP ("if (rd_dsize > 0), that means the FPGA is alive.\n");
-    //     DP ("we need to release the rx_tc(transfer for RX) when FPGA is alive.\n");
-    //     DP ("Otherwise, the system will be locked.\n");
-    //     DP ("this workaround is ugly; thought I can't come out other solution yet. -ysli\n");
-    //     if (board->io.usb.rx_tc) {
-    //         ret = ftdi_transfer_data_done (board->io.usb.rx_tc);
-    //         if (ret < 0) {
-    //             ERRP("ret (%d) (%s)\n", ret , ftdi_get_error_string(ftdic));
-    //         } 
-    //         board->io.usb.rx_tc = NULL;
-    //     }
-    // }
+    return M7I43U_RECONFIG_MS;
+}
+
+/**
+ * m7i43u_flush_rx - drop whatever the FPGA sent while being reconfigured
+ **/
+static void m7i43u_flush_rx (board_t* board)
+{
+    uint8_t cBufWrite;
+    int ret;
+    struct ftdi_context *ftdic;
     
+    ftdic = &(board->io.usb.ftdic);
+    printf ("rd_dsize(%llu), rx_tc(%p)\n", board->rd_dsize, board->io.usb.rx_tc);
     // to flush rx queue
     while (ret = ftdi_read_data (ftdic, &cBufWrite, 1) > 0) { 
         printf ("flush %d byte\n", ret);
@@ -1814,49 +3003,39 @@ static void m7i43u_reconfig (board_t* board)
                             ftdic->readbuffer_remaining);
         }
     }
-    
-    return;
 }
 
-// for 7i43 USB version
-static int m7i43u_program_fpga(struct board *board, 
-                               struct bitfile_chunk *ch) 
+/**
+ * m7i43u_load_fpga - reset the CPLD and send the bitstream
+ *  call M7I43U_RECONFIG_MS after m7i43u_reconfig()
+ *  return ms for the FPGA to start up, -1 on error
+ **/
+static int m7i43u_load_fpga (struct board *board, struct bitfile_chunk *ch) 
 {
-    // 
-    // reset the FPGA, then send appropriate firmware
-    //
-    printf ("begin: m7i43u_program_fpga()\n");
-    
-    // if (board_reset(board)) {
-    //     return EC_HDW;  // FTDI reset fail
-    // }
-    
-    printf("DEBUG: about to m7i43u_reconfig\n");
-    m7i43u_reconfig (board);
-    printf("DEBUG: after m7i43u_reconfig...\n");
-    
+    wou_fpga_stats_t *stats = &(board->wou->fpga_stats);
+    uint64_t t0;
+
+    m7i43u_flush_rx (board);
 
     printf("about to m7i43u_cpld_reset\n");
+    t0 = wou_time_ns ();
     if (!m7i43u_cpld_reset(board)) {
         printf("error resetting FPGA, aborting load\n");
         return -1;
     }
+    stats->reset_ns = wou_time_ns () - t0;
     
     printf("about to m7i43u_cpld_send_firmware\n");
+    t0 = wou_time_ns ();
     if (!m7i43u_cpld_send_firmware(board, ch)) {
         printf("ERROR: sending FPGA firmware\n");
         return -1;
     }
+    stats->send_ns = wou_time_ns () - t0;
     
     // in Linux, there are 519 bytes show up on the RxQueue after
     // programming. TODO: where does it come from?
-    struct timespec time;
-    time.tv_sec = 0;
-    time.tv_nsec = 500000000;   // 500ms
-    nanosleep(&time, NULL);
-    
-    printf ("end: m7i43u_program_fpga()\n");
-    return 0;
+    return M7I43U_SETTLE_MS;
 }
 
 static void diff_time(struct timespec *start, struct timespec *end,
@@ -1,6 +1,8 @@
 #ifndef __MESA_H__
 #define __MESA_H__ 
 
+#include <assert.h>
+
 /* Exit codes */
 #define EC_OK    0   /* Exit OK. */
 #define EC_BADCL 100 /* Bad command line. */
@@ -96,6 +98,29 @@ static const _Ftstat Ftstat[] = {
 // GO-BACK-N: http://en.wikipedia.org/wiki/Go-Back-N_ARQ
 #define NR_OF_WIN     64     // window size for GO-BACK-N
 #define NR_OF_CLK     255    // number of circular buffer for WOU_FRAMEs
+#define NR_OF_RSV     5      // number of empty woufs ahead of the clock pointer
+#define WOUF_INIT_SIZE  7    // fsize of an empty wouf: {PREAMBLE x2, SOFD, PLOAD_SIZE_TX, WOUF_COMMAND, TID, PLOAD_SIZE_RX}
+
+#define NR_OF_RDQ     1024   // pending asynchronous reads, must be power of 2
+#define NR_OF_BITQ    4      // bulk writes in flight while programming the FPGA
+#define BITQ_SIZE     16384  // bytes per bulk write of the bitstream
+#define PROBE_TIMEOUT_MS 50  // time for a running FPGA to respond board_probe()
+#define M7I43U_RECONFIG_MS 100  // 7i43u: from GPIO_RECONFIG to CPLD reset
+#define M7I43U_SETTLE_MS   500  // 7i43u: from the end of bitstream to GBN
+#define CONN_ACK_TIMEOUT_NS 2000000000LL   // the first ACK of a connection
+#define RECONNECT_RETRY_NS  10000000LL      // board_reconnect() retry while unplugged
+#define RANGE_CHUNK   123    // 2 packets per wouf: 3 + 2*(WOU_HDR_SIZE+RANGE_CHUNK) <= MAX_PSIZE
+#define RANGE_BATCH   32     // packets per board_cmdv() of board_write_range()
+#define SYNC_CMD_MAX  32     // JCMD_SYNC_CMD takes up to 32 bytes per write
+#define SYNC_DATA_CMD_WORDS 5 // 4 SYNC_DATA and a command, see board_sync_data_cmd()
+
+// board_wait_until(): spin for spin_ns, then block on USB for WAIT_SLICE_NS at most
+#define WAIT_SPIN_MIN_NS    2000        // 2us
+#define WAIT_SPIN_MAX_NS    200000      // 200us
+#define WAIT_SLICE_NS       1000000     // 1ms, bounds the latency of TX_TIMEOUT
+
+// board_risc_prog(): a resident image must send a mail within this to be kept
+#define RISC_ALIVE_NS       100000000   // 100ms
 
 enum rx_state_type {
   SYNC=0, PLOAD_CRC
@@ -115,6 +140,69 @@ typedef struct wouf_struct {
 
 // typedef void (*wou_mailbox_cb_fn)(const uint8_t *buf_head);
 
+#define WOUF_TMPL_FIELDS    16  // patchable data fields per wouf template
+
+/**
+ * wouf_field_t - a patchable byte range of a wouf template
+ * @offset:     position in wouf.buf[]
+ * @dsize:      size in bytes
+ * @adv:        CRC change caused by the remainder of the field delta,
+ *              looked up by its low[0] and high[1] byte
+ **/
+typedef struct wouf_field_struct {
+    uint16_t    offset;
+    uint16_t    dsize;
+    uint16_t    adv[2][256];
+} wouf_field_t;
+
+/**
+ * wouf_tmpl - a recorded wouf to be sent again and again
+ * @wouf:       the WOU_FRAME; header and CRC are valid once sealed
+ * @sealed:     no more packets could be added
+ * @nfields:    number of patchable fields
+ * @field:      DATA of the WB_WR_CMD packets
+ * @tid:        the TID byte, patched by board_tmpl_send()
+ **/
+struct wouf_tmpl {
+    wouf_t          wouf;
+    int             sealed;
+    int             nfields;
+    wouf_field_t    field[WOUF_TMPL_FIELDS];
+    wouf_field_t    tid;
+};
+
+/**
+ * throttle_t - statistics of producers throttled by a full WOUFS
+ * @eagain:         times of returning -EAGAIN to a non-blocking producer
+ * @timeouts:       times of a bounded wait getting expired
+ * @waits:          times of a producer waiting for an empty wouf
+ * @wait_ns:        accumulated waiting time
+ * @wait_ns_max:    the longest waiting time
+ **/
+typedef struct throttle_struct {
+    uint32_t    eagain;
+    uint32_t    timeouts;
+    uint32_t    waits;
+    uint64_t    wait_ns;
+    uint64_t    wait_ns_max;
+} throttle_t;
+
+/**
+ * rdq_t - an asynchronous read waiting for its response wouf
+ * @key:        (epoch << 8 | tid) of the wouf carrying the WB_RD_CMD
+ * @wb_addr:    wishbone address to read from
+ * @dsize:      data size in bytes
+ * @cb:         completion callback
+ * @ctx:        context for @cb
+ **/
+typedef struct rdq_struct {
+    uint64_t            key;
+    uint16_t            wb_addr;
+    uint16_t            dsize;
+    libwou_read_cb_fn   cb;
+    void                *ctx;
+} rdq_t;
+
 /**
  * wou_t - circular buffer to keep track of wou packets
  * //obsolete: @frame_id:     // frame_id (appeared at 1st WOU packet: FF00<frame_id>00)
@@ -124,20 +212,236 @@ typedef struct wouf_struct {
  * //obsolete: @head_wait:          head of wou packets which is waiting for ACK
  * @tid:                transaction id for the upcomming wouf
  * @tidSb:              transaction id for sequence base(Sb)
+ * @tid_epoch:          times of tid wrapping around
+ * @ack_epoch:          times of tidSb wrapping around
  * @woufs[NR_OF_CLK]:   circular clock array of WOU_FRAMEs
  * @rt_wouf:            realtime WOU_FRAME
+ * @tx_frag:            bytes at the head of buf_tx[] that belong to a
+ *                      WOU_FRAME which is partially written to USB already
  * @clock:              clock pointer for next available wouf buffer
  * @Rn:                 request number
  * @Sn:                 sequence number
  * @Sb:                 sequence base of GBN
  * @Sm:                 sequence max of GBN
+ * @Sh:                 sequence high-water: first wouf never copied to buf_tx[]
+ * @throttle:           statistics of producers throttled by a full WOUFS
+ * @spin_ns:            adaptive spinning time of board_wait_until()
+ * @rdq[NR_OF_RDQ]:     FIFO of asynchronous reads, ordered by their wouf
+ * @rdq_head:           next read to complete, free running
+ * @rdq_tail:           next empty rdq slot, free running
+ * @rx_time_ns:         time of the latest completed USB read
+ * @mail_count:         mails received, free running
+ * @sync_pkt:           offset of the JCMD_SYNC_CMD packet board_sync_push() 
+ *                      keeps extending in the current wouf; -1 once the
+ *                      wouf is sealed or any other packet is appended
+ * @params:             host copy of motion/machine parameters, see param.c
+ * @snap_path:          board_close() saves a snapshot here, see snapshot.c
+ * @prog_stats:         statistics of the latest board_risc_prog()
+ * @fpga_stats:         time spent on each phase of the latest board_connect()
+ * @hot_attach:         (1) skip programming the FPGA if the bitfile is still running
+ * @conn:               progress of the non-blocking connect, see connect.c
+ * @link:               health of the USB link, see board_reconnect()
+ * @log:                the open log of mails, see log.c
+ * @rpc:                requests in flight to the RISC firmware, see rpc.c
+ * @sfifo:              host model of the SYNC command FIFO, see sfifo.c
+ * @csync:              fit of bp_tick onto CLOCK_MONOTONIC, see clock.c
+ **/
+struct wou_params;
+
+/**
+ * SHADOW_* - offsets of the write-only PLAIN registers of WB_REG_TABLE in 
+ *            board->shadow[]; the other registers take no space
+ **/
+#define SHADOW_BYTES(WIDTH, COUNT, ACCESS, KIND)                        \
+    ((((ACCESS) == WB_ACC_W) && ((KIND) == WB_KIND_PLAIN)) ? ((WIDTH) * (COUNT)) : 0)
+#define SHADOW_ENUM(NAME, ADDR, WIDTH, COUNT, ACCESS, KIND)             \
+    SHADOW_OFF_##NAME,                                                  \
+    SHADOW_END_##NAME = SHADOW_OFF_##NAME + SHADOW_BYTES(WIDTH, COUNT, ACCESS, KIND) - 1,
+enum {
+    WB_REG_TABLE(SHADOW_ENUM)
+    SHADOW_SIZE
+};
+struct bitfile;
+
+/**
+ * conn_t - progress of the non-blocking connect
+ * @state:      WOU_CONN_*
+ * @binfile:    RISC image to load after the first ACK; NULL for none
+ * @bf:         the mapped bitfile while programming the FPGA
+ * @t_begin:    time of board_connect_start()
+ * @t_phase:    time the current phase began
+ * @not_before: the current phase waits for the FPGA until then
+ * @ticket:     the wouf whose ACK completes the connection
+ * @stats:      time spent on each phase
+ **/
+typedef struct {
+    int             state;
+    const char      *binfile;
+    struct bitfile  *bf;
+    uint64_t        t_begin;
+    uint64_t        t_phase;
+    uint64_t        not_before;
+    wou_ticket_t    ticket;
+    wou_conn_stats_t stats;
+} conn_t;
+
+/**
+ * link_t - health of the USB link
+ * @lost:       (1) a transfer failed; board_reconnect() is due
+ * @gone:       (1) hotplug reported the device left; reopen it
+ * @recovering: (1) waiting for the first ACK after board_reconnect()
+ * @hotplug:    (1) hotplug_handle is registered
+ * @hotplug_handle: libusb_hotplug_callback_handle
+ * @t_lost:     time the failure was detected
+ * @t_retry:    board_reconnect() is not retried before then
+ * @stats:      time-to-recovery
  **/
+typedef struct {
+    int             lost;
+    int             gone;
+    int             recovering;
+    int             hotplug;
+    int             hotplug_handle;
+    uint64_t        t_lost;
+    uint64_t        t_retry;
+    wou_reconn_stats_t stats;
+} link_t;
+
+enum rpc_state {
+    RPC_FREE = 0,
+    RPC_PENDING,
+    RPC_DONE
+};
+
+/**
+ * rpc_slot_t - a request of wou_rpc_call()
+ * @id:         gen * WOU_RPC_MAX + index of the slot
+ * @seq:        issue order; the oldest matching request takes a reply
+ * @status:     -EINPROGRESS, then the status of the completion
+ * @t_issue:    time of wou_rpc_call()
+ * @deadline:   UINT64_MAX without timeout
+ **/
+typedef struct {
+    enum rpc_state  state;
+    uint32_t        gen;
+    uint32_t        id;
+    int             status;
+    uint64_t        seq;
+    wou_rpc_req_t   req;
+    libwou_rpc_cb_fn cb;
+    void            *ctx;
+    uint64_t        t_issue;
+    uint64_t        deadline;
+} rpc_slot_t;
+
+/**
+ * rpc_t - requests in flight to the RISC firmware
+ * @pending_tags:   bitmap of the reply_tag of the pending requests
+ * @next_deadline:  the earliest deadline of the pending requests
+ **/
+typedef struct {
+    rpc_slot_t      slot[WOU_RPC_MAX];
+    uint64_t        seq;
+    uint32_t        nr_pending;
+    uint32_t        pending_tags;
+    uint64_t        next_deadline;
+    wou_rpc_stats_t stats;
+} rpc_t;
+
+#define NR_SFIFO_RD     8       // pending reads of the SFIFO level register
+#define NR_SFIFO_TK     256     // unacknowledged woufs carrying SYNC words, >= NR_OF_CLK
+
+/**
+ * sfifo_t - host model of SFIFO, see sfifo.c
+ * @pushed:         SYNC words given to board_sync_push()
+ * @acked:          SYNC words of the acknowledged woufs, i.e. received by
+ *                  the FPGA
+ * @consumed:       SYNC words taken by the firmware, an estimate:
+ *                  est capped at acked
+ * @est:            SYNC words taken by the firmware, from bp_tick, the
+ *                  level register and underruns
+ * @want:           words board_sfifo_reserve() waits credits for
+ * @waiting:        (1) in board_sfifo_reserve(); no nested waits
+ * @low_armed:      (1) level is above low_water
+ * @bp_tick:        of the latest mail, if tick_valid
+ * @rd_pushed:      pushed when each pending level read was issued
+ * @tk[]:           the wouf holding the last word of board_sync_push(),
+ *                  with tk_pushed[] at that time; oldest first
+ * @t_level:        the next level read is not issued before then
+ **/
+typedef struct {
+    wou_sfifo_cfg_t cfg;
+    libwou_sfifo_cb_fn cb;
+    void            *ctx;
+    uint64_t        pushed;
+    uint64_t        acked;
+    uint64_t        consumed;
+    uint64_t        est;
+    int             want;
+    int             waiting;
+    int             low_armed;
+    int             tick_valid;
+    uint32_t        bp_tick;
+    uint64_t        rd_pushed[NR_SFIFO_RD];
+    uint32_t        rd_head;
+    uint32_t        rd_tail;
+    wou_ticket_t    tk[NR_SFIFO_TK];
+    uint64_t        tk_pushed[NR_SFIFO_TK];
+    uint32_t        tk_head;
+    uint32_t        tk_tail;
+    uint64_t        t_level;
+    wou_sfifo_stats_t stats;
+} sfifo_t;
+
+typedef struct {
+    uint64_t        tick;
+    uint64_t        rx_ns;
+} csync_sample_t;
+
+/**
+ * csync_t - fit of bp_tick onto CLOCK_MONOTONIC, see clock.c
+ * @window:         samples of the fit; (0) off
+ * @bp_ns:          nominal base period
+ * @bp_tick:        of the latest sample
+ * @tick:           ... extended to 64 bits
+ * @count:          samples taken, ring[count % window] is the next one
+ * @grp_n:          ticks of the current group
+ * @grp_first:      the first tick of the group
+ * @sample:         the earliest tick of the group so far, its delay grp_min
+ * @tick_ref, @time_ref, @period_ns:
+ *                  time(k) = time_ref + (k - tick_ref) * period_ns
+ * @jitter_ns:      spread of the delays of the latest group
+ **/
+typedef struct {
+    uint32_t        window;
+    uint32_t        bp_ns;
+    uint32_t        bp_tick;
+    uint32_t        resets;
+    uint64_t        tick;
+    uint64_t        count;
+    int             started;
+    int             locked;
+    uint32_t        grp_n;
+    csync_sample_t  grp_first;
+    csync_sample_t  sample;
+    double          grp_min;
+    double          grp_max;
+    uint64_t        tick_ref;
+    uint64_t        time_ref;
+    double          period_ns;
+    double          jitter_ns;
+    csync_sample_t  ring[WOU_CLOCK_MAX_WINDOW];
+} csync_t;
+
 typedef struct wou_struct {
   uint8_t     tid;       
   uint8_t     tidSb;
+  uint32_t    tid_epoch;
+  uint32_t    ack_epoch;
   wouf_t      woufs[NR_OF_CLK];    
   wouf_t      rt_wouf;
   int         tx_size;
+  int         tx_frag;
   int         rx_size;
   int         rx_req_size;
   int         rx_req;
@@ -149,11 +453,34 @@ typedef struct wou_struct {
   uint8_t     Sn;
   uint8_t     Sb;    
   uint8_t     Sm;    
+  uint8_t     Sh;
+  throttle_t  throttle;
+  uint32_t    spin_ns;
+  rdq_t       rdq[NR_OF_RDQ];
+  uint32_t    rdq_head;
+  uint32_t    rdq_tail;
+  uint64_t    rx_time_ns;
+  uint32_t    mail_count;
+  int         sync_pkt;
+  struct wou_params *params;
+  const char  *snap_path;
   uint32_t    crc_error_counter;
   // callback functional pointers
   libwou_mailbox_cb_fn mbox_callback;
+  wou_mbox_sub_t *mbox_subs[WOU_MBOX_MAX_SUBS];
+  wou_log_t   *log;
+  rpc_t       rpc;
+  sfifo_t     sfifo;
+  csync_t     csync;
   libwou_crc_error_cb_fn crc_error_callback;
   libwou_rt_cmd_cb_fn rt_cmd_callback;
+  libwou_progress_cb_fn prog_callback;
+  void        *prog_ctx;
+  wou_prog_stats_t prog_stats;
+  wou_fpga_stats_t fpga_stats;
+  int         hot_attach;
+  conn_t      conn;
+  link_t      link;
 } wou_t;
 
 //
@@ -181,6 +508,7 @@ typedef struct board {
             unsigned short  vendor_id;
             unsigned short  device_id;
             int             usb_devnum;
+            char            usb_key[40];    // FTDI serial or bus-port path, see cache.c
             const char*     bitfile;    // NULL for not-programming fpga
 #ifdef HAVE_LIBFTD2XX
             FT_HANDLE	    ftHandle;
@@ -203,26 +531,194 @@ typedef struct board {
 
     // wisbone register map for this board
     uint8_t wb_reg_map[WB_REG_SIZE];
+
+    // host written configuration registers, see snapshot.c
+    uint8_t shadow[SHADOW_SIZE];
+    uint8_t shadow_valid[SHADOW_SIZE];
     
     //obsolete: // mailbox buffer for this board
     //obsolete: uint8_t mbox_buf[WOUF_HDR_SIZE+MAX_PSIZE+CRC_SIZE+3];   // +3: for 4 bytes alignment
     
-    int (*program_funct) (struct board *bd, struct bitfile_chunk *ch);
+    // return ms to wait before the next step, -1 on error
+    int (*reconfig_funct) (struct board *bd);
+    int (*load_funct) (struct board *bd, struct bitfile_chunk *ch);
 } board_t;
-int board_risc_prog(board_t* board, const char* binfile);
+int board_risc_prog(board_t* board, const char* binfile, int cached);
+uint64_t wou_fnv1a (const uint8_t *buf, size_t len);
+int board_risc_cache_hit (const board_t* b, uint64_t hash, uint32_t size);
+void board_risc_cache_store (const board_t* b, uint64_t hash, uint32_t size);
+void board_risc_cache_drop (const board_t* b);
+uint64_t bitfile_fingerprint (struct bitfile *bf);
+int board_fpga_cache_hit (const board_t* b, uint64_t fingerprint, uint32_t size);
+void board_fpga_cache_store (const board_t* b, uint64_t fingerprint, uint32_t size);
+void board_fpga_cache_drop (const board_t* b);
 int board_init (board_t* board, const char* device_type, const int device_id,
                 const char* bitfile);
 int board_connect (board_t* board);
+int board_reconnect (board_t* board);
+int board_connect_start (board_t* board, const char *binfile);
+int board_connect_poll (board_t* board, uint32_t *wait_us);
+int board_usb_open (board_t* board);
+void board_gbn_start (board_t* board);
+int board_hot_attach (board_t* board);
+struct bitfile *board_bitfile_open (board_t* board);
 int board_close (board_t* board);
+size_t board_params_size (void);
+const void *board_params_image (board_t* b);
+int board_params_load (board_t* b, const void *image);
+int board_params_commit (board_t* b, wou_ticket_t *ticket);
+void board_shadow_init (void);
+void board_shadow_wr (board_t* b, uint16_t wb_addr, uint16_t dsize, const uint8_t *buf);
+int board_snapshot_save (board_t* b, const char *path);
+int board_restore (board_t* b, const char *path, wou_ticket_t *ticket);
+wou_mbox_sub_t *board_mbox_subscribe (board_t* b, uint32_t tags, uint32_t depth);
+void board_mbox_unsubscribe (board_t* b, wou_mbox_sub_t *sub);
+void board_mbox_post (board_t* b, const uint8_t *buf_head);
+int board_log_open (board_t* b, const char *path, uint32_t tags, int nwords,
+                    const wou_log_reg_t *regs, int nregs);
+int board_log_close (board_t* b);
+void board_log_mail (board_t* b, const uint8_t *buf_head);
+void board_log_stats (board_t* b, wou_log_stats_t *stats);
+int board_clock_config (board_t* b, uint32_t bp_ns, uint32_t window);
+void board_clock_mail (board_t* b, const uint8_t *buf_head);
+int board_clock_tick_time (board_t* b, uint64_t tick, uint64_t *t_ns);
+int board_clock_next_send (board_t* b, uint32_t margin_ns, uint64_t *send_ns, uint64_t *tick);
+void board_clock_stats (board_t* b, wou_clock_stats_t *stats);
+int board_sfifo_config (board_t* b, const wou_sfifo_cfg_t *cfg,
+                        libwou_sfifo_cb_fn cb, void *ctx);
+void board_sfifo_reserve (board_t* b, int n);
+void board_sfifo_track (board_t* b);
+void board_sfifo_mail (board_t* b, const uint8_t *buf_head);
+uint32_t board_sfifo_credits (board_t* b);
+void board_sfifo_stats (board_t* b, wou_sfifo_stats_t *stats);
+int board_rpc_call (board_t* b, const wou_rpc_req_t *req,
+                    libwou_rpc_cb_fn cb, void *ctx);
+void board_rpc_mail (board_t* b, const uint8_t *buf_head);
+void board_rpc_expire (board_t* b);
+void board_rpc_cancel (board_t* b);
+int board_rpc_status (board_t* b, int id);
 int board_status (board_t* board);
 int board_reset (board_t* board);
+int board_abort_now (board_t* board, int discard, uint32_t *latency_ns);
+int board_wait_until (board_t* board, libwou_pred_fn pred, void *ctx, int64_t timeout_ns);
+wou_ticket_t board_fence (board_t* board);
+int board_is_acked (board_t* board, wou_ticket_t ticket);
+int board_read_async (board_t* board, uint16_t wb_addr, uint16_t dsize, 
+                      libwou_read_cb_fn cb, void *ctx);
+int board_cmdv (board_t* board, const wou_op_t *ops, int n);
+int board_write_range (board_t* board, uint16_t wb_addr, uint32_t len, 
+                       const uint8_t *src, wou_ticket_t *ticket);
+int board_read_range (board_t* board, uint16_t wb_addr, uint32_t len, 
+                      uint8_t *dst, libwou_range_cb_fn cb, void *ctx);
+uint64_t wou_time_ns (void);
 // int board_prog (board_t* board, char* filename);
 
 void wou_append (board_t* b, const uint8_t func, const uint16_t wb_addr, 
                  const uint16_t dsize, const uint8_t* buf);
+int wou_append_wait (board_t* b, const uint8_t func, const uint16_t wb_addr, 
+                     const uint16_t dsize, const uint8_t* buf, int64_t timeout_ns);
 void wou_recv (board_t* b);
 int wou_eof (board_t* b, uint8_t wouf_cmd);
+int wou_eof_wait (board_t* b, uint8_t wouf_cmd, int64_t timeout_ns);
+int wou_occupancy (board_t* b);
 void wouf_init (board_t* b);
+void wouf_clear (wouf_t *wou_frame_);
+
+/**
+ * wouf_fits_size - check if a [WOU] packet fits into a wouf of fsize
+ *                  and pload_size_rx
+ **/
+static inline int wouf_fits_size (const uint16_t fsize, const uint16_t pload_size_rx,
+                                  const uint8_t func, const uint16_t dsize)
+{
+    // avoid exceeding WOUF_PAYLOAD limit
+    // CRC_SIZE is not counted in PLOAD_SIZE_TX
+    if (func == WB_WR_CMD) {
+        return ((fsize - WOUF_HDR_SIZE + WOU_HDR_SIZE + dsize) <= MAX_PSIZE);
+    } else if (func == WB_RD_CMD) {
+        return (((fsize - WOUF_HDR_SIZE + WOU_HDR_SIZE) <= MAX_PSIZE) 
+                && 
+                ((pload_size_rx + WOU_HDR_SIZE + dsize) <= MAX_PSIZE));
+    }
+    assert (0); // not a valid func
+    return 0;
+}
+
+/**
+ * wouf_fits - check if a [WOU] packet fits into the current wouf
+ **/
+static inline int wouf_fits (const wouf_t *wou_frame_, const uint8_t func, 
+                             const uint16_t dsize)
+{
+    return wouf_fits_size (wou_frame_->fsize, wou_frame_->pload_size_rx, 
+                           func, dsize);
+}
+
+/**
+ * wouf_put - put a [WOU] packet at the end of a WOU_FRAME
+ *            the caller has to make sure that the packet fits into the frame
+ **/
+static inline void wouf_put (wouf_t *wou_frame_, const uint8_t func, 
+                             const uint16_t wb_addr, const uint16_t dsize, 
+                             const uint8_t* buf)
+{
+    uint16_t    i;
+
+    // code took from vip/ftdi/generator.cpp:
+    i = wou_frame_->fsize;
+    wou_frame_->buf[i] = 0xFF & (func | (0x7F & dsize));
+    i++;
+    memcpy (wou_frame_->buf + i, &wb_addr, WB_ADDR_SIZE);
+    i+= WB_ADDR_SIZE;
+    if (func == WB_WR_CMD) {
+        memcpy (wou_frame_->buf + i, buf, dsize);
+        wou_frame_->fsize = i + dsize;
+    } else  if (func == WB_RD_CMD) {
+        wou_frame_->fsize = i;
+        wou_frame_->pload_size_rx += (WOU_HDR_SIZE + dsize);
+    }
+}
+
+/**
+ * wou_append_wr - wou_append(WB_WR_CMD) without argument checking
+ *  the caller guarantees (dsize <= MAX_DSIZE); func is constant, so
+ *  wouf_fits() and wouf_put() fold into a direct append
+ **/
+static inline void wou_append_wr (board_t* b, const uint16_t wb_addr, 
+                                  const uint16_t dsize, const uint8_t* buf)
+{
+    if (!wouf_fits (&(b->wou->woufs[b->wou->clock]), WB_WR_CMD, dsize)) {
+        wou_eof_wait (b, TYP_WOUF, -1);
+    }
+    wouf_put (&(b->wou->woufs[b->wou->clock]), WB_WR_CMD, wb_addr, dsize, buf);
+    b->wou->sync_pkt = -1;
+    board_shadow_wr (b, wb_addr, dsize, buf);
+}
+
+/**
+ * wou_append_rd - wou_append(WB_RD_CMD) without argument checking
+ *  the caller guarantees (dsize <= MAX_DSIZE)
+ **/
+static inline void wou_append_rd (board_t* b, const uint16_t wb_addr, 
+                                  const uint16_t dsize)
+{
+    if (!wouf_fits (&(b->wou->woufs[b->wou->clock]), WB_RD_CMD, dsize)) {
+        wou_eof_wait (b, TYP_WOUF, -1);
+    }
+    wouf_put (&(b->wou->woufs[b->wou->clock]), WB_RD_CMD, wb_addr, dsize, NULL);
+    b->wou->sync_pkt = -1;
+}
+
+struct wouf_tmpl *wouf_tmpl_new (void);
+void wouf_tmpl_free (struct wouf_tmpl *t);
+int wouf_tmpl_cmd (struct wouf_tmpl *t, const uint8_t func, const uint16_t wb_addr, 
+                   const uint16_t dsize, const uint8_t *data, int *field);
+int wouf_tmpl_seal (struct wouf_tmpl *t);
+int wouf_tmpl_patch (struct wouf_tmpl *t, int field, const uint8_t *data);
+void wouf_tmpl_tid (struct wouf_tmpl *t, uint8_t tid);
+int board_tmpl_send (board_t* board, struct wouf_tmpl *t, int64_t timeout_ns);
+void board_sync_push (board_t* board, const uint16_t *cmds, int n);
+uint16_t *board_sync_data_cmd (uint16_t *cmds, uint32_t val, uint16_t cmd);
 
 void rt_wouf_init (board_t* b);
 void rt_wou_append (board_t* b, const uint8_t func, const uint16_t wb_addr, 
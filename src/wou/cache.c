@@ -0,0 +1,239 @@
+/**
+ * cache.c - remember the bitstream and RISC image programmed on each board
+ *
+ * After the FPGA is programmed (see connect.c) or board_risc_prog() the
+ * FNV-1a hash and the size of the image are written to $LIBWOU_CACHE_DIR,
+ * one record per board type, FTDI device and kind. The device is named
+ * by its serial number, else by its USB bus and port path (usb_key() of
+ * board.c), as the device_id does not tell which board ftdi_usb_open()
+ * takes; no record is kept for a device without either. The directory
+ * defaults to $XDG_RUNTIME_DIR, or else to a /tmp/libwou-<uid> of mode
+ * 0700. Records are written to a mkstemp() file and renamed into place,
+ * and never read through a symbolic link.
+ * Reconfiguring the FPGA clears the OR32 SRAM, so the RISC record is
+ * dropped before programming. A record is only a hint: the FPGA is
+ * probed, and the RISC has to be sending mails, before an upload is
+ * skipped (see board_hot_attach() and board_risc_prog()). The probe only
+ * proves that a WOU design is alive, not which one: a board programmed
+ * with another design behind the back of libwou is not noticed.
+ *
+ * Copyright (C) 2009 Yishin Li <ysli@araisrobo.com>
+ **/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <config.h>
+#ifdef HAVE_LIBFTD2XX
+#include <ftd2xx.h>     // from FTDI
+#else
+#ifdef HAVE_LIBFTDI
+#include <ftdi.h>       // from FTDI
+#endif  // HAVE_LIBFTDI
+#endif  // HAVE_LIBFTD2XX
+
+#include "wb_regs.h"
+#include "wou.h"
+#include "board.h"
+#include "bitfile.h"
+
+#define RISC_CACHE_MAGIC    0x52495343  // "RISC"
+#define FPGA_CACHE_MAGIC    0x46504741  // "FPGA"
+
+#define FNV_OFFSET_BASIS    0xCBF29CE484222325ULL
+#define FNV_PRIME           0x00000100000001B3ULL
+
+typedef struct {
+    uint32_t    magic;
+    uint32_t    size;
+    uint64_t    hash;
+} cache_rec_t;
+
+static uint64_t fnv1a_update (uint64_t h, const uint8_t *buf, size_t len)
+{
+    size_t      i;
+
+    for (i = 0; i < len; i++) {
+        h ^= buf[i];
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+uint64_t wou_fnv1a (const uint8_t *buf, size_t len)
+{
+    return fnv1a_update (FNV_OFFSET_BASIS, buf, len);
+}
+
+/**
+ * bitfile_fingerprint - hash of the 'a' ~ 'd' chunks (design name, part,
+ *                       date and time) followed by the 'e' chunk (bitstream)
+ **/
+uint64_t bitfile_fingerprint (struct bitfile *bf)
+{
+    struct bitfile_chunk *ch;
+    const char  *tag;
+    uint64_t    h;
+
+    h = FNV_OFFSET_BASIS;
+    for (tag = "abcde"; *tag; tag++) {
+        ch = bitfile_find_chunk (bf, *tag, 0);
+        if (ch) {
+            h = fnv1a_update (h, (const uint8_t *) tag, 1);
+            h = fnv1a_update (h, ch->body, ch->len);
+        }
+    }
+    return h;
+}
+
+/**
+ * cache_dir - the directory of the records
+ *  return NULL if the per-user directory in /tmp is not ours
+ **/
+static const char *cache_dir (char *buf, size_t len)
+{
+    const char  *dir;
+    struct stat st;
+
+    dir = getenv ("LIBWOU_CACHE_DIR");
+    if ((dir != NULL) && (dir[0] != '\0')) {
+        return dir;
+    }
+    dir = getenv ("XDG_RUNTIME_DIR");
+    if ((dir != NULL) && (dir[0] != '\0')) {
+        return dir;
+    }
+    snprintf (buf, len, "/tmp/libwou-%d", (int) getuid ());
+    if ((mkdir (buf, 0700) != 0) && (errno != EEXIST)) {
+        ERRP ("%s: %s\n", buf, strerror(errno));
+        return NULL;
+    }
+    // someone else may have made it first
+    if ((lstat (buf, &st) != 0) || !S_ISDIR(st.st_mode) ||
+        (st.st_uid != getuid ()) || ((st.st_mode & 077) != 0)) {
+        ERRP ("%s: not a private directory\n", buf);
+        return NULL;
+    }
+    return buf;
+}
+
+static int cache_path (const board_t* b, const char *ext, char *path, size_t len)
+{
+    char        buf[64];
+    const char  *dir;
+
+    dir = cache_dir (buf, sizeof(buf));
+    if (dir == NULL) {
+        return -1;
+    }
+    if (b->io.usb.usb_key[0] == '\0') {
+        return -1;  // the device cannot be told from another one
+    }
+    snprintf (path, len, "%s/libwou-%s-%s.%s", dir, b->board_type,
+              b->io.usb.usb_key, ext);
+    return 0;
+}
+
+static int cache_hit (const board_t* b, const char *ext, uint32_t magic,
+                      uint64_t hash, uint32_t size)
+{
+    char            path[256];
+    cache_rec_t     rec;
+    int             fd;
+    int             n;
+
+    if (cache_path (b, ext, path, sizeof(path)) != 0) {
+        return 0;
+    }
+    fd = open (path, O_RDONLY | O_NOFOLLOW);
+    if (fd < 0) {
+        return 0;
+    }
+    n = read (fd, &rec, sizeof(rec));
+    close (fd);
+    return ((n == sizeof(rec)) && (rec.magic == magic) &&
+            (rec.size == size) && (rec.hash == hash));
+}
+
+static void cache_store (const board_t* b, const char *ext, uint32_t magic,
+                         uint64_t hash, uint32_t size)
+{
+    char            path[256];
+    char            tmp[272];
+    cache_rec_t     rec;
+    int             fd;
+    int             n;
+
+    if (cache_path (b, ext, path, sizeof(path)) != 0) {
+        return;
+    }
+    snprintf (tmp, sizeof(tmp), "%s.XXXXXX", path);
+    rec.magic = magic;
+    rec.size = size;
+    rec.hash = hash;
+    fd = mkstemp (tmp);
+    if (fd < 0) {
+        ERRP ("%s: %s\n", tmp, strerror(errno));
+        return;
+    }
+    n = write (fd, &rec, sizeof(rec));
+    if ((close (fd) != 0) || (n != sizeof(rec)) || (rename (tmp, path) != 0)) {
+        ERRP ("%s: %s\n", path, strerror(errno));
+        unlink (tmp);
+    }
+}
+
+static void cache_drop (const board_t* b, const char *ext)
+{
+    char            path[256];
+
+    if (cache_path (b, ext, path, sizeof(path)) == 0) {
+        unlink (path);
+    }
+}
+
+/**
+ * board_risc_cache_hit - the image of hash is the last one programmed
+ *                        since the FPGA was configured
+ **/
+int board_risc_cache_hit (const board_t* b, uint64_t hash, uint32_t size)
+{
+    return cache_hit (b, "risc", RISC_CACHE_MAGIC, hash, size);
+}
+
+void board_risc_cache_store (const board_t* b, uint64_t hash, uint32_t size)
+{
+    cache_store (b, "risc", RISC_CACHE_MAGIC, hash, size);
+}
+
+void board_risc_cache_drop (const board_t* b)
+{
+    cache_drop (b, "risc");
+}
+
+/**
+ * board_fpga_cache_hit - the bitstream of fingerprint is the last one
+ *                        programmed into the FPGA
+ **/
+int board_fpga_cache_hit (const board_t* b, uint64_t fingerprint, uint32_t size)
+{
+    return cache_hit (b, "fpga", FPGA_CACHE_MAGIC, fingerprint, size);
+}
+
+void board_fpga_cache_store (const board_t* b, uint64_t fingerprint, uint32_t size)
+{
+    cache_store (b, "fpga", FPGA_CACHE_MAGIC, fingerprint, size);
+}
+
+void board_fpga_cache_drop (const board_t* b)
+{
+    cache_drop (b, "fpga");
+}
+
+// vim:sw=4:sts=4:et:
@@ -0,0 +1,267 @@
+/**
+ * clock.c - map the base period tick of the FPGA onto CLOCK_MONOTONIC
+ *
+ * Each MT_MOTION_STATUS and MT_TICK mail gives (bp_tick, rx_time_ns).
+ * USB only ever adds delay, so of every CLOCK_GROUP ticks only the mail
+ * received the earliest (against the current period) is kept as a
+ * sample; this takes out most of the USB jitter and stretches the
+ * window over CLOCK_GROUP times as many ticks. A least squares line
+ * through the samples of the window gives the base period as seen by
+ * the host clock (drift included); the line is then moved down to the
+ * earliest sample. The RX parser refits once per group only.
+ *
+ * tick_time(k) is therefore when the mail of tick k would arrive on the
+ * quickest USB round; board_clock_next_send() schedules the servo
+ * thread a margin ahead of it.
+ *
+ * Copyright (C) 2009 Yishin Li <ysli@araisrobo.com>
+ **/
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <config.h>
+#ifdef HAVE_LIBFTD2XX
+#include <ftd2xx.h>     // from FTDI
+#else
+#ifdef HAVE_LIBFTDI
+#include <ftdi.h>       // from FTDI
+#endif  // HAVE_LIBFTDI
+#endif  // HAVE_LIBFTD2XX
+
+#include "wb_regs.h"
+#include "wou.h"
+#include "board.h"
+#include "mailtag.h"
+
+#define CLOCK_GROUP         16      // ticks per sample
+#define CLOCK_MIN_SAMPLES   8       // samples of the first fit
+
+static int64_t clock_round (double x)
+{
+    return (int64_t) ((x < 0) ? (x - 0.5) : (x + 0.5));
+}
+
+/* least squares over the ring, relative to the newest sample */
+static void clock_fit (csync_t *c)
+{
+    const csync_sample_t *s;
+    const csync_sample_t *last;
+    double      dx;
+    double      dy;
+    double      mx;
+    double      my;
+    double      sxx;
+    double      sxy;
+    double      a;
+    double      b;
+    double      r;
+    double      rmin;
+    uint64_t    n;
+    uint64_t    i;
+
+    n = (c->count < c->window) ? c->count : c->window;
+    last = &(c->ring[(c->count - 1) % c->window]);
+    mx = my = 0;
+    for (i = 0; i < n; i++) {
+        s = &(c->ring[(c->count - 1 - i) % c->window]);
+        mx += (double) (int64_t) (s->tick - last->tick);
+        my += (double) (int64_t) (s->rx_ns - last->rx_ns);
+    }
+    mx /= n;
+    my /= n;
+    sxx = sxy = 0;
+    for (i = 0; i < n; i++) {
+        s = &(c->ring[(c->count - 1 - i) % c->window]);
+        dx = (double) (int64_t) (s->tick - last->tick) - mx;
+        dy = (double) (int64_t) (s->rx_ns - last->rx_ns) - my;
+        sxx += dx * dx;
+        sxy += dx * dy;
+    }
+    if (sxx <= 0) {
+        return;
+    }
+    b = sxy / sxx;
+    a = my - b * mx;
+    rmin = 0;
+    for (i = 0; i < n; i++) {
+        s = &(c->ring[(c->count - 1 - i) % c->window]);
+        r = (double) (int64_t) (s->rx_ns - last->rx_ns) -
+            (a + b * (double) (int64_t) (s->tick - last->tick));
+        if ((i == 0) || (r < rmin)) {
+            rmin = r;
+        }
+    }
+    c->tick_ref = last->tick;
+    c->time_ref = last->rx_ns + clock_round (a + rmin);
+    c->period_ns = b;
+    c->locked = 1;
+}
+
+/**
+ * board_clock_mail - take the bp_tick of a mail as a sample
+ *  called by wouf_parse() while the clock sync is configured
+ **/
+void board_clock_mail (board_t* b, const uint8_t *buf_head)
+{
+    csync_t     *c;
+    uint16_t    tag;
+    uint32_t    bp_tick;
+    int32_t     dt;
+    double      period;
+    double      delay;
+
+    c = &(b->wou->csync);
+    tag = mail_tag (buf_head);
+    if (((tag != MT_MOTION_STATUS) && (tag != MT_TICK)) ||
+        (MAIL_PLOAD_SIZE(buf_head) < (int) sizeof(mail_tick_t))) {
+        return;
+    }
+    bp_tick = ((const mail_tick_t *) (buf_head + MAIL_HDR_SIZE))->bp_tick;
+    if (c->started) {
+        dt = (int32_t) (bp_tick - c->bp_tick);
+        if (dt == 0) {
+            return;
+        }
+        if (dt < 0) {
+            // the firmware restarted; start over
+            c->started = 0;
+            c->count = 0;
+            c->grp_n = 0;
+            c->locked = 0;
+            c->resets ++;
+        }
+    }
+    if (!c->started) {
+        c->tick = bp_tick;
+        c->started = 1;
+    } else {
+        c->tick += (uint32_t) (bp_tick - c->bp_tick);
+    }
+    c->bp_tick = bp_tick;
+
+    // USB delay of the mail, up to a constant of the group
+    period = c->locked ? c->period_ns : c->bp_ns;
+    if (c->grp_n == 0) {
+        c->grp_first.tick = c->tick;
+        c->grp_first.rx_ns = b->wou->rx_time_ns;
+    }
+    delay = (double) (int64_t) (b->wou->rx_time_ns - c->grp_first.rx_ns) -
+            period * (double) (int64_t) (c->tick - c->grp_first.tick);
+    if ((c->grp_n == 0) || (delay < c->grp_min)) {
+        c->grp_min = delay;
+        c->sample.tick = c->tick;
+        c->sample.rx_ns = b->wou->rx_time_ns;
+    }
+    if ((c->grp_n == 0) || (delay > c->grp_max)) {
+        c->grp_max = delay;
+    }
+    c->grp_n ++;
+    if (c->grp_n < CLOCK_GROUP) {
+        return;
+    }
+    c->grp_n = 0;
+    c->jitter_ns = c->grp_max - c->grp_min;
+    c->ring[c->count % c->window] = c->sample;
+    c->count ++;
+    if (c->count >= CLOCK_MIN_SAMPLES) {
+        clock_fit (c);
+    }
+}
+
+/**
+ * board_clock_config - (re)start the clock sync
+ *  return 0 on success, INVALID_DATA for a bad window, or no bp_ns to
+ *         pick the samples with until the first fit
+ **/
+int board_clock_config (board_t* b, uint32_t bp_ns, uint32_t window)
+{
+    csync_t     *c;
+
+    c = &(b->wou->csync);
+    if (window && ((window < CLOCK_MIN_SAMPLES) || (window > WOU_CLOCK_MAX_WINDOW) ||
+                   (bp_ns == 0))) {
+        return INVALID_DATA;
+    }
+    memset (c, 0, sizeof(csync_t));
+    c->window = window;
+    c->bp_ns = bp_ns;
+    return 0;
+}
+
+/**
+ * board_clock_tick_time - CLOCK_MONOTONIC time of tick
+ *  return 0 on success, -EAGAIN until enough samples are taken
+ **/
+int board_clock_tick_time (board_t* b, uint64_t tick, uint64_t *t_ns)
+{
+    const csync_t *c;
+
+    c = &(b->wou->csync);
+    if (!c->locked) {
+        return -EAGAIN;
+    }
+    *t_ns = c->time_ref + clock_round ((double) (int64_t) (tick - c->tick_ref) * c->period_ns);
+    return 0;
+}
+
+/**
+ * board_clock_next_send - the first tick whose time is margin_ns or more
+ *                         ahead of now, and the time to send for it
+ *  return 0 on success, -EAGAIN until enough samples are taken
+ **/
+int board_clock_next_send (board_t* b, uint32_t margin_ns, uint64_t *send_ns, uint64_t *tick)
+{
+    const csync_t *c;
+    uint64_t    now;
+    uint64_t    k;
+    uint64_t    t = 0;
+    uint64_t    t0 = 0;
+    double      ahead;
+
+    c = &(b->wou->csync);
+    if (!c->locked || (c->period_ns <= 0)) {
+        return -EAGAIN;
+    }
+    now = wou_time_ns ();
+    ahead = ((double) (int64_t) (now + margin_ns - c->time_ref)) / c->period_ns;
+    k = c->tick_ref + clock_round (ahead);
+    board_clock_tick_time (b, k, &t);
+    while (t < now + margin_ns) {
+        k ++;
+        board_clock_tick_time (b, k, &t);
+    }
+    while ((board_clock_tick_time (b, k - 1, &t0) == 0) && (t0 >= now + margin_ns)) {
+        k --;
+        t = t0;
+    }
+    *send_ns = t - margin_ns;
+    if (tick) {
+        *tick = k;
+    }
+    return 0;
+}
+
+void board_clock_stats (board_t* b, wou_clock_stats_t *stats)
+{
+    const csync_t *c;
+
+    c = &(b->wou->csync);
+    memset (stats, 0, sizeof(wou_clock_stats_t));
+    stats->locked = c->locked;
+    stats->samples = c->count;
+    stats->jitter_ns = c->jitter_ns;
+    stats->resets = c->resets;
+    stats->tick = c->tick;
+    if (c->locked) {
+        stats->period_ns = c->period_ns;
+        if (c->bp_ns) {
+            stats->drift_ppm = (c->period_ns - c->bp_ns) * 1e6 / c->bp_ns;
+        }
+    }
+}
+
+// vim:sw=4:sts=4:et:
@@ -0,0 +1,263 @@
+/**
+ * connect.c - non-blocking connect
+ *
+ * board_connect_poll() runs one phase of the connect per call. The fixed
+ * delays of the 7i43u (RECONFIG and start up of the FPGA) are deadlines
+ * instead of sleeps, so the caller's event loop keeps running while the
+ * FPGA comes up. Sending the bitstream and loading the RISC image take
+ * one call each. The RISC image is loaded only after the first ACK, as
+ * board_risc_prog() waits for the ACKs of its woufs without a limit.
+ *
+ * Copyright (C) 2009 Yishin Li <ysli@araisrobo.com>
+ **/
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <config.h>
+#ifdef HAVE_LIBFTD2XX
+#include <ftd2xx.h>     // from FTDI
+#else
+#ifdef HAVE_LIBFTDI
+#include <ftdi.h>       // from FTDI
+#endif  // HAVE_LIBFTDI
+#endif  // HAVE_LIBFTD2XX
+
+#include "wb_regs.h"
+#include "wou.h"
+#include "board.h"
+#include "bitfile.h"
+
+typedef struct {
+    board_t         *board;
+    wou_ticket_t    ticket;
+} conn_ack_t;
+
+static int conn_acked_cond (void *ctx)
+{
+    const conn_ack_t *a = ctx;
+    return board_is_acked (a->board, a->ticket);
+}
+
+/* close the phase and account its time to *ns */
+static void conn_next (conn_t *c, int state, uint64_t *ns, uint64_t now)
+{
+    if (ns) {
+        *ns += now - c->t_phase;
+    }
+    c->t_phase = now;
+    c->state = state;
+}
+
+/* an empty wouf proves the link is up */
+static void conn_first_ack (board_t* board)
+{
+    conn_t      *c;
+
+    c = &(board->wou->conn);
+    wou_eof_wait (board, TYP_WOUF, -1);
+    c->ticket = board_fence (board);
+}
+
+static int conn_fail (board_t* board)
+{
+    conn_t      *c;
+
+    c = &(board->wou->conn);
+    if (c->bf) {
+        bitfile_free (c->bf);
+        c->bf = NULL;
+    }
+    c->state = WOU_CONN_FAILED;
+    return c->state;
+}
+
+int board_connect_start (board_t* board, const char *binfile)
+{
+    conn_t      *c;
+
+    c = &(board->wou->conn);
+    if ((c->state != WOU_CONN_IDLE) && (c->state != WOU_CONN_DONE) &&
+        (c->state != WOU_CONN_FAILED)) {
+        return -EBUSY;
+    }
+    memset (c, 0, sizeof(conn_t));
+    memset (&(board->wou->fpga_stats), 0, sizeof(wou_fpga_stats_t));
+    c->binfile = binfile;
+    c->t_begin = wou_time_ns ();
+    c->t_phase = c->t_begin;
+    c->state = WOU_CONN_USB_OPEN;
+    return 0;
+}
+
+/**
+ * board_connect_poll - run the current phase if it is not waiting for
+ *                      the FPGA
+ *  return the current phase
+ **/
+int board_connect_poll (board_t* board, uint32_t *wait_us)
+{
+    conn_t      *c;
+    wou_fpga_stats_t *fs;
+    struct bitfile_chunk *ch;
+    conn_ack_t  ack;
+    uint64_t    now;
+    int         ret;
+
+    c = &(board->wou->conn);
+    fs = &(board->wou->fpga_stats);
+    now = wou_time_ns ();
+    if (wait_us) {
+        *wait_us = 0;
+    }
+    if (now < c->not_before) {
+        if (wait_us) {
+            *wait_us = (c->not_before - now + 999) / 1000;
+        }
+        return c->state;
+    }
+
+    switch (c->state) {
+    case WOU_CONN_USB_OPEN:
+        if (board_usb_open (board) != 0) {
+            return conn_fail (board);
+        }
+        conn_next (c, WOU_CONN_ATTACH, &c->stats.usb_open_ns, wou_time_ns ());
+        break;
+
+    case WOU_CONN_ATTACH:
+        if (board->io.usb.bitfile == NULL) {
+            conn_next (c, WOU_CONN_GBN, &c->stats.reconfig_ns, wou_time_ns ());
+            break;
+        }
+        if (board->wou->hot_attach && board_hot_attach (board)) {
+            c->stats.hot_attach = 1;
+            conn_next (c, WOU_CONN_GBN, &c->stats.reconfig_ns, wou_time_ns ());
+            break;
+        }
+        c->bf = board_bitfile_open (board);
+        if (c->bf == NULL) {
+            return conn_fail (board);
+        }
+        board_risc_cache_drop (board);  // OR32 SRAM is lost
+        board_fpga_cache_drop (board);
+        fs->bytes = bitfile_find_chunk (c->bf, 'e', 0)->len;
+        fs->map_ns = wou_time_ns () - now;
+        conn_next (c, WOU_CONN_RECONFIG, &c->stats.reconfig_ns, wou_time_ns ());
+        break;
+
+    case WOU_CONN_RECONFIG:
+        printf ("Loading configuration %s into %s at USB-%x...\n",
+                c->bf->filename, board->board_type, board->io.usb.usb_devnum);
+        ret = board->reconfig_funct (board);
+        if (ret < 0) {
+            ERRP ("configuration did not load\n");
+            return conn_fail (board);
+        }
+        now = wou_time_ns ();
+        fs->reconfig_ns = now - c->t_phase;
+        c->not_before = now + (uint64_t) ret * 1000000;
+        conn_next (c, WOU_CONN_BITSTREAM, &c->stats.reconfig_ns, now);
+        break;
+
+    case WOU_CONN_BITSTREAM:
+        fs->reconfig_ns += now - c->t_phase;
+        conn_next (c, WOU_CONN_BITSTREAM, &c->stats.reconfig_ns, now);
+        ch = bitfile_find_chunk (c->bf, 'e', 0);
+        ret = board->load_funct (board, ch);
+        if (ret < 0) {
+            ERRP ("configuration did not load\n");
+            return conn_fail (board);
+        }
+        board_fpga_cache_store (board, bitfile_fingerprint (c->bf), ch->len);
+        bitfile_free (c->bf);
+        c->bf = NULL;
+        now = wou_time_ns ();
+        c->not_before = now + (uint64_t) ret * 1000000;
+        fs->settle_ns = now;    // completed in WOU_CONN_GBN
+        c->state = WOU_CONN_GBN;
+        break;
+
+    case WOU_CONN_GBN:
+        if (fs->settle_ns) {
+            fs->settle_ns = now - fs->settle_ns;
+            printf ("FPGA: reconfig(%" PRIu64 "us) reset(%" PRIu64 "us) "
+                    "send(%" PRIu64 "us) settle(%" PRIu64 "us)\n",
+                    fs->reconfig_ns / 1000, fs->reset_ns / 1000,
+                    fs->send_ns / 1000, fs->settle_ns / 1000);
+            conn_next (c, WOU_CONN_GBN, &c->stats.bitstream_ns, now);
+        }
+        board_gbn_start (board);
+        fs->connect_ns = wou_time_ns () - c->t_begin;
+        conn_first_ack (board);
+        conn_next (c, WOU_CONN_FIRST_ACK, &c->stats.first_ack_ns, wou_time_ns ());
+        break;
+
+    case WOU_CONN_FIRST_ACK:
+        ack.board = board;
+        ack.ticket = c->ticket;
+        board_wait_until (board, conn_acked_cond, &ack, 0);
+        now = wou_time_ns ();
+        if (board_is_acked (board, c->ticket)) {
+            if (c->binfile) {
+                conn_next (c, WOU_CONN_RISC, &c->stats.first_ack_ns, now);
+                break;
+            }
+            conn_next (c, WOU_CONN_DONE, &c->stats.first_ack_ns, now);
+            c->stats.total_ns = now - c->t_begin;
+            break;
+        }
+        if ((int64_t) (now - c->t_phase) > CONN_ACK_TIMEOUT_NS) {
+            ERRP ("no ACK from the FPGA in %lld ms\n", CONN_ACK_TIMEOUT_NS / 1000000);
+            return conn_fail (board);
+        }
+        if (wait_us) {
+            *wait_us = 1000;
+        }
+        break;
+
+    case WOU_CONN_RISC:
+        if (board_risc_prog (board, c->binfile, 1) < 0) {
+            return conn_fail (board);
+        }
+        now = wou_time_ns ();
+        conn_next (c, WOU_CONN_DONE, &c->stats.risc_ns, now);
+        c->stats.total_ns = now - c->t_begin;
+        break;
+
+    default:
+        break;
+    }
+    return c->state;
+}
+
+/**
+ * board_connect - connect the board and program the FPGA if a bitfile
+ *                 is provided; returns once the GBN window is up, as it
+ *                 always did, without waiting for the first ACK
+ *  return 0 on success, -1 on failure
+ **/
+int board_connect (board_t* board)
+{
+    uint32_t    wait_us;
+    int         state;
+
+    if (board_connect_start (board, NULL) != 0) {
+        return -1;
+    }
+    do {
+        state = board_connect_poll (board, &wait_us);
+        if (wait_us) {
+            usleep (wait_us);
+        }
+    } while ((state != WOU_CONN_FIRST_ACK) && (state != WOU_CONN_DONE) &&
+             (state != WOU_CONN_FAILED));
+    return (state == WOU_CONN_FAILED) ? -1 : 0;
+}
+
+// vim:sw=4:sts=4:et:
@@ -251,3 +251,81 @@ crcFast(unsigned char const message[], int nBytes)
     return (REFLECT_REMAINDER(remainder) ^ FINAL_XOR_VALUE);
 
 }   /* crcFast() */
+
+
+/*********************************************************************
+ *
+ * Function:    crcRemainder()
+ * 
+ * Description: Continue dividing a message by the polynomial from the
+ *				given (un-reflected) remainder.
+ *
+ * Notes:		crcInit() must be called first.
+ *				The result is neither reflected nor XORed; use
+ *				crcFinal() to turn it into a CRC.
+ *
+ * Returns:		The remainder after the message.
+ *
+ *********************************************************************/
+crc
+crcRemainder(crc remainder, unsigned char const message[], int nBytes)
+{
+    unsigned char  data;
+	int            byte;
+
+    for (byte = 0; byte < nBytes; ++byte)
+    {
+        data = REFLECT_DATA(message[byte]) ^ (remainder >> (WIDTH - 8));
+  	remainder = crcTable[data] ^ (remainder << 8);
+    }
+
+    return (remainder);
+
+}   /* crcRemainder() */
+
+
+/*********************************************************************
+ *
+ * Function:    crcZeros()
+ * 
+ * Description: Advance a remainder over nBytes of zeros.
+ *
+ * Notes:		crcInit() must be called first.
+ *				The CRC is linear when INITIAL_REMAINDER is zero,
+ *				so the CRC change caused by patching bytes of a
+ *				message is the remainder of the XOR delta, advanced
+ *				over the bytes following the patch.
+ *
+ * Returns:		The remainder after the zeros.
+ *
+ *********************************************************************/
+crc
+crcZeros(crc remainder, int nBytes)
+{
+	int            byte;
+
+    for (byte = 0; byte < nBytes; ++byte)
+    {
+  	remainder = crcTable[(remainder >> (WIDTH - 8)) & 0xFF] ^ (remainder << 8);
+    }
+
+    return (remainder);
+
+}   /* crcZeros() */
+
+
+/*********************************************************************
+ *
+ * Function:    crcFinal()
+ * 
+ * Description: Turn a remainder into a CRC.
+ *
+ * Returns:		The CRC of the remainder.
+ *
+ *********************************************************************/
+crc
+crcFinal(crc remainder)
+{
+    return (REFLECT_REMAINDER(remainder) ^ FINAL_XOR_VALUE);
+
+}   /* crcFinal() */
@@ -76,6 +76,9 @@ typedef unsigned long  crc;
 void  crcInit(void);
 crc   crcSlow(unsigned char const message[], int nBytes);
 crc   crcFast(unsigned char const message[], int nBytes);
+crc   crcRemainder(crc remainder, unsigned char const message[], int nBytes);
+crc   crcZeros(crc remainder, int nBytes);
+crc   crcFinal(crc remainder);
 
 
 #endif /* _crc_h */
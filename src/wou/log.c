@@ -0,0 +1,405 @@
+/**
+ * log.c - columnar log of mails and register samples
+ *
+ * The RX parser appends one record per logged mail into the current block
+ * of a ring of NR_LOG_BLOCKS in-memory blocks, column by column: a few
+ * stores per column, no lock, no system call. A full block is handed to
+ * the flusher thread by a release store of log->produced. The flusher
+ * copies the blocks into a shared mapping of the log file, LOG_MAP_SIZE
+ * bytes at a time, and advances log->flushed. If the flusher falls
+ * NR_LOG_BLOCKS behind the records are dropped and counted.
+ *
+ * The file format is in wou_log.h; wou-log2csv converts it.
+ *
+ * Copyright (C) 2009 Yishin Li <ysli@araisrobo.com>
+ **/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <config.h>
+#ifdef HAVE_LIBFTD2XX
+#include <ftd2xx.h>     // from FTDI
+#else
+#ifdef HAVE_LIBFTDI
+#include <ftdi.h>       // from FTDI
+#endif  // HAVE_LIBFTDI
+#endif  // HAVE_LIBFTD2XX
+
+#include "wb_regs.h"
+#include "wou.h"
+#include "wou_log.h"
+#include "board.h"
+
+#define NR_LOG_BLOCKS   8               // power of 2
+#define LOG_BLOCK_ROWS  1024
+#define LOG_MAP_SIZE    (4 << 20)       // file window of the flusher
+#define LOG_FLUSH_NS    10000000        // 10ms flusher period
+
+/**
+ * wou_log - a log and its flusher
+ * @tags:       WOU_MBOX_TAG(MT_*) bitmap of logged mails
+ * @nwords:     mail payload words per record
+ * @regs:       register columns, after the mail words
+ * @col_off:    offset of each column in a block
+ * @cur:        block being filled; RX parser only
+ * @rows:       records in cur; RX parser only
+ * @produced:   blocks handed to the flusher
+ * @flushed:    blocks written by the flusher
+ * @map:        file window [map_base, map_base + LOG_MAP_SIZE)
+ * @written:    bytes of the file in use
+ **/
+struct wou_log {
+    uint32_t    tags;
+    int         nwords;
+    int         nregs;
+    int         ncols;
+    wou_log_reg_t regs[WOU_LOG_MAX_REGS];
+    uint32_t    col_off[WOU_LOG_MAX_COLS];
+    uint32_t    blk_size;
+    uint8_t     *blk[NR_LOG_BLOCKS];
+
+    uint8_t     *cur;
+    uint32_t    rows;
+    uint32_t    produced;
+    uint64_t    records;
+    uint64_t    dropped;
+
+    uint32_t    flushed;
+    int         stop;
+    int         error;
+    int         fd;
+    uint8_t     *map;
+    uint64_t    map_base;
+    uint64_t    written;
+    pthread_t   flusher;
+};
+
+/* append len bytes to the file through the mapped window */
+static int log_put (wou_log_t *log, const void *src, uint32_t len)
+{
+    const uint8_t *p;
+    uint64_t    off;
+    uint32_t    n;
+
+    p = src;
+    while (len > 0) {
+        off = log->written - log->map_base;
+        if ((log->map == NULL) || (off == LOG_MAP_SIZE)) {
+            if (log->map) {
+                munmap (log->map, LOG_MAP_SIZE);
+                log->map = NULL;
+                log->map_base += LOG_MAP_SIZE;
+                off = 0;
+            }
+            if (ftruncate (log->fd, log->map_base + LOG_MAP_SIZE) != 0) {
+                return -errno;
+            }
+            log->map = mmap (NULL, LOG_MAP_SIZE, PROT_READ | PROT_WRITE,
+                             MAP_SHARED, log->fd, log->map_base);
+            if (log->map == MAP_FAILED) {
+                log->map = NULL;
+                return -errno;
+            }
+        }
+        n = LOG_MAP_SIZE - off;
+        if (n > len) {
+            n = len;
+        }
+        memcpy (log->map + off, p, n);
+        log->written += n;
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/* write the blocks handed over by board_log_mail() */
+static void log_flush (wou_log_t *log)
+{
+    wlog_blk_t  *hdr;
+    uint32_t    produced;
+    uint8_t     *blk;
+
+    produced = __atomic_load_n (&(log->produced), __ATOMIC_ACQUIRE);
+    while (log->flushed != produced) {
+        blk = log->blk[log->flushed & (NR_LOG_BLOCKS - 1)];
+        if (log->error == 0) {
+            log->error = log_put (log, blk, log->blk_size);
+        }
+        if (log->error) {
+            hdr = (wlog_blk_t *) blk;
+            __atomic_fetch_add (&(log->dropped), hdr->rows, __ATOMIC_RELAXED);
+        }
+        __atomic_store_n (&(log->flushed), log->flushed + 1, __ATOMIC_RELEASE);
+    }
+    if (log->map) {
+        msync (log->map, LOG_MAP_SIZE, MS_ASYNC);
+    }
+}
+
+static void *log_flusher (void *arg)
+{
+    wou_log_t   *log;
+    struct timespec ts;
+
+    log = arg;
+    ts.tv_sec = 0;
+    ts.tv_nsec = LOG_FLUSH_NS;
+    while (!__atomic_load_n (&(log->stop), __ATOMIC_ACQUIRE)) {
+        log_flush (log);
+        nanosleep (&ts, NULL);
+    }
+    return NULL;
+}
+
+static void log_free (wou_log_t *log)
+{
+    int         i;
+
+    if (log->map) {
+        munmap (log->map, LOG_MAP_SIZE);
+    }
+    if (log->fd >= 0) {
+        ftruncate (log->fd, log->written);
+        close (log->fd);
+    }
+    for (i = 0; i < NR_LOG_BLOCKS; i++) {
+        free (log->blk[i]);
+    }
+    free (log);
+}
+
+/* the file header: wlog_hdr_t, the columns, zeros up to hdr_size */
+static int log_put_hdr (wou_log_t *log, const wlog_col_t *cols)
+{
+    uint8_t     buf[sizeof(wlog_hdr_t) + WOU_LOG_MAX_COLS * sizeof(wlog_col_t) + WLOG_HDR_ALIGN];
+    wlog_hdr_t  hdr;
+    uint32_t    size;
+
+    size = sizeof(hdr) + log->ncols * sizeof(wlog_col_t);
+    size = (size + WLOG_HDR_ALIGN - 1) & ~(WLOG_HDR_ALIGN - 1);
+    memset (&hdr, 0, sizeof(hdr));
+    hdr.magic = WLOG_MAGIC;
+    hdr.version = WLOG_VERSION;
+    hdr.ncols = log->ncols;
+    hdr.block_rows = LOG_BLOCK_ROWS;
+    hdr.hdr_size = size;
+    hdr.blk_size = log->blk_size;
+    memset (buf, 0, size);
+    memcpy (buf, &hdr, sizeof(hdr));
+    memcpy (buf + sizeof(hdr), cols, log->ncols * sizeof(wlog_col_t));
+    return log_put (log, buf, size);
+}
+
+static void log_col (wlog_col_t *col, const char *name, uint8_t type, uint16_t wb_addr)
+{
+    memset (col, 0, sizeof(wlog_col_t));
+    snprintf (col->name, sizeof(col->name), "%s", name);
+    col->type = type;
+    col->width = (type == WLOG_U64) ? sizeof(uint64_t) : sizeof(uint32_t);
+    col->wb_addr = wb_addr;
+}
+
+/**
+ * board_log_open - start logging to path
+ *  return 0 on success, INVALID_DATA for a bad column set or if a log
+ *         is open already, -errno on failure
+ **/
+int board_log_open (board_t* b, const char *path, uint32_t tags, int nwords,
+                    const wou_log_reg_t *regs, int nregs)
+{
+    wlog_col_t  cols[WOU_LOG_MAX_COLS];
+    wou_log_t   *log;
+    uint32_t    off;
+    char        name[WLOG_NAME_SIZE];
+    int         ret;
+    int         i;
+
+    if ((b->wou->log != NULL) || (nwords < 0) || (nregs < 0) ||
+        (nregs > WOU_LOG_MAX_REGS) || (2 + nwords + nregs > WOU_LOG_MAX_COLS)) {
+        return INVALID_DATA;
+    }
+    for (i = 0; i < nregs; i++) {
+        if ((regs[i].dsize == 0) || (regs[i].dsize > sizeof(uint32_t)) ||
+            ((uint32_t) regs[i].wb_addr + regs[i].dsize > WB_REG_SIZE)) {
+            return INVALID_DATA;
+        }
+    }
+    log = calloc (1, sizeof(wou_log_t));
+    if (log == NULL) {
+        return -ENOMEM;
+    }
+    log->fd = -1;
+    log->tags = tags;
+    log->nwords = nwords;
+    log->nregs = nregs;
+    log->ncols = 2 + nwords + nregs;
+    memcpy (log->regs, regs, nregs * sizeof(wou_log_reg_t));
+
+    // the u64 time goes first so each column is aligned
+    log_col (&cols[0], "rx_time_ns", WLOG_U64, 0);
+    log_col (&cols[1], "tag", WLOG_U32, 0);
+    for (i = 0; i < nwords; i++) {
+        // every typed mail of mailtag.h begins with bp_tick
+        snprintf (name, sizeof(name), "w%d", i);
+        log_col (&cols[2 + i], name, (i == 0) ? WLOG_U32 : WLOG_I32, 0);
+    }
+    for (i = 0; i < nregs; i++) {
+        log_col (&cols[2 + nwords + i], regs[i].name,
+                 regs[i].is_signed ? WLOG_I32 : WLOG_U32, regs[i].wb_addr);
+    }
+    off = sizeof(wlog_blk_t);
+    for (i = 0; i < log->ncols; i++) {
+        log->col_off[i] = off;
+        off += cols[i].width * LOG_BLOCK_ROWS;
+    }
+    log->blk_size = off;
+    for (i = 0; i < NR_LOG_BLOCKS; i++) {
+        log->blk[i] = malloc (log->blk_size);
+        if (log->blk[i] == NULL) {
+            log_free (log);
+            return -ENOMEM;
+        }
+    }
+
+    log->fd = open (path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (log->fd < 0) {
+        ret = -errno;
+        ERRP ("%s: %s\n", path, strerror(errno));
+        log_free (log);
+        return ret;
+    }
+    ret = log_put_hdr (log, cols);
+    if (ret == 0) {
+        ret = -pthread_create (&(log->flusher), NULL, log_flusher, log);
+    }
+    if (ret != 0) {
+        ERRP ("%s: %s\n", path, strerror(-ret));
+        log_free (log);
+        return ret;
+    }
+    __atomic_store_n (&(b->wou->log), log, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/**
+ * board_log_close - stop logging, write the partial block and
+ *                   trim the file
+ *  return 0 on success, -errno if the log lost records to a write error
+ **/
+int board_log_close (board_t* b)
+{
+    wou_log_t   *log;
+    wlog_blk_t  *hdr;
+    int         ret;
+
+    log = b->wou->log;
+    if (log == NULL) {
+        return 0;
+    }
+    __atomic_store_n (&(b->wou->log), NULL, __ATOMIC_RELEASE);
+    __atomic_store_n (&(log->stop), 1, __ATOMIC_RELEASE);
+    pthread_join (log->flusher, NULL);
+
+    if (log->cur && log->rows) {
+        hdr = (wlog_blk_t *) log->cur;
+        hdr->magic = WLOG_BLK_MAGIC;
+        hdr->rows = log->rows;
+        log->produced ++;
+    }
+    log_flush (log);
+    ret = log->error;
+    log_free (log);
+    return ret;
+}
+
+/**
+ * board_log_mail - append a record for a mail
+ *  called by wouf_parse() while a log is open
+ **/
+void board_log_mail (board_t* b, const uint8_t *buf_head)
+{
+    const wou_log_reg_t *r;
+    wou_log_t   *log;
+    wlog_blk_t  *hdr;
+    uint8_t     *cur;
+    uint16_t    tag;
+    uint32_t    row;
+    uint32_t    nsize;
+    uint32_t    v;
+    int         i;
+
+    log = b->wou->log;
+    memcpy (&tag, buf_head + 2, sizeof(uint16_t));
+    if ((tag >= 32) || !(log->tags & ((uint32_t) 1 << tag))) {
+        return;
+    }
+    if (log->cur == NULL) {
+        if (log->produced - __atomic_load_n (&(log->flushed), __ATOMIC_ACQUIRE)
+            >= NR_LOG_BLOCKS) {
+            __atomic_fetch_add (&(log->dropped), 1, __ATOMIC_RELAXED);
+            return;
+        }
+        log->cur = log->blk[log->produced & (NR_LOG_BLOCKS - 1)];
+    }
+    cur = log->cur;
+    row = log->rows;
+
+    ((uint64_t *) (cur + log->col_off[0]))[row] = b->wou->rx_time_ns;
+    ((uint32_t *) (cur + log->col_off[1]))[row] = tag;
+    nsize = buf_head[0] - 3;    // payload bytes
+    for (i = 0; i < log->nwords; i++) {
+        v = 0;
+        if ((uint32_t) (i + 1) * sizeof(uint32_t) <= nsize) {
+            memcpy (&v, buf_head + 4 + i * sizeof(uint32_t), sizeof(uint32_t));
+        }
+        ((uint32_t *) (cur + log->col_off[2 + i]))[row] = v;
+    }
+    for (i = 0; i < log->nregs; i++) {
+        r = &(log->regs[i]);
+        v = 0;
+        memcpy (&v, &(b->wb_reg_map[r->wb_addr]), r->dsize);
+        if (r->is_signed && (r->dsize < sizeof(uint32_t)) &&
+            (v & ((uint32_t) 1 << (r->dsize * 8 - 1)))) {
+            v |= ~(((uint32_t) 1 << (r->dsize * 8)) - 1);
+        }
+        ((uint32_t *) (cur + log->col_off[2 + log->nwords + i]))[row] = v;
+    }
+    __atomic_store_n (&(log->records), log->records + 1, __ATOMIC_RELAXED);
+
+    log->rows = row + 1;
+    if (log->rows == LOG_BLOCK_ROWS) {
+        hdr = (wlog_blk_t *) cur;
+        hdr->magic = WLOG_BLK_MAGIC;
+        hdr->rows = LOG_BLOCK_ROWS;
+        log->cur = NULL;
+        log->rows = 0;
+        __atomic_store_n (&(log->produced), log->produced + 1, __ATOMIC_RELEASE);
+    }
+}
+
+void board_log_stats (board_t* b, wou_log_stats_t *stats)
+{
+    wou_log_t   *log;
+
+    memset (stats, 0, sizeof(wou_log_stats_t));
+    log = b->wou->log;
+    if (log == NULL) {
+        return;
+    }
+    stats->records = __atomic_load_n (&(log->records), __ATOMIC_RELAXED);
+    stats->dropped = __atomic_load_n (&(log->dropped), __ATOMIC_RELAXED);
+    stats->blocks = __atomic_load_n (&(log->flushed), __ATOMIC_RELAXED);
+    stats->pending = __atomic_load_n (&(log->produced), __ATOMIC_RELAXED) - stats->blocks;
+}
+
+// vim:sw=4:sts=4:et:
@@ -0,0 +1,60 @@
+/**
+ * mail.c - dispatch mails to handlers by MAIL_TAG
+ *
+ * The table is indexed by the tag, and the payload size is checked
+ * against the fixed fields of the tag's mail_*_t view (see mailtag.h)
+ * once, here, so handlers read the fields in place.
+ *
+ * Copyright (C) 2009 Yishin Li <ysli@araisrobo.com>
+ **/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "wb_regs.h"
+#include "wou.h"
+#include "mailtag.h"
+
+void wou_mail_dispatch_init (wou_mail_dispatch_t *d)
+{
+    int         i;
+
+    memset (d, 0, sizeof(wou_mail_dispatch_t));
+    for (i = 0; i < WOU_MAIL_NR_TAGS; i++) {
+        d->min_size[i] = mail_min_size (i);
+    }
+}
+
+int wou_mail_on (wou_mail_dispatch_t *d, uint16_t tag, libwou_mail_handler_fn fn, void *ctx)
+{
+    if (tag >= WOU_MAIL_NR_TAGS) {
+        return INVALID_DATA;
+    }
+    d->fn[tag] = fn;
+    d->ctx[tag] = ctx;
+    return 0;
+}
+
+void wou_mail_dispatch (void *dispatch, const uint8_t *buf_head, uint64_t rx_time_ns)
+{
+    wou_mail_dispatch_t *d;
+    uint16_t    tag;
+    uint32_t    size;
+
+    d = (wou_mail_dispatch_t *) dispatch;
+    tag = mail_tag (buf_head);
+    if ((tag >= WOU_MAIL_NR_TAGS) || (d->fn[tag] == NULL)) {
+        d->unhandled ++;
+        return;
+    }
+    size = MAIL_PLOAD_SIZE(buf_head);
+    if (size < d->min_size[tag]) {
+        d->short_mails ++;
+        return;
+    }
+    d->dispatched ++;
+    d->fn[tag] (d->ctx[tag], buf_head + MAIL_HDR_SIZE, size, rx_time_ns);
+}
+
+// vim:sw=4:sts=4:et:
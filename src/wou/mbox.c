@@ -0,0 +1,185 @@
+/**
+ * mbox.c - mailbox rings
+ *
+ * The RX parser (the thread pumping USB I/O) is the only producer:
+ * board_mbox_post() copies each mail into the ring of every subscriber
+ * of its tag. Each ring has one consumer, wou_mbox_drain(). head is
+ * written by the producer and tail by the consumer only, published with
+ * release stores, so neither side takes a lock nor waits for the other.
+ *
+ * Copyright (C) 2009 Yishin Li <ysli@araisrobo.com>
+ **/
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <config.h>
+#ifdef HAVE_LIBFTD2XX
+#include <ftd2xx.h>     // from FTDI
+#else
+#ifdef HAVE_LIBFTDI
+#include <ftdi.h>       // from FTDI
+#endif  // HAVE_LIBFTDI
+#endif  // HAVE_LIBFTD2XX
+
+#include "wb_regs.h"
+#include "wou.h"
+#include "board.h"
+
+#define MBOX_SLOT_SIZE  256     // {PLOAD_SIZE_TX, MAILBOX, payload} fits in
+#define CACHE_LINE      64
+
+/**
+ * mbox_slot_t - a copy of a mail
+ * @rx_time_ns: wou_time_ns() when the mail was received
+ * @buf:        the mail as passed to libwou_mailbox_cb_fn
+ **/
+typedef struct {
+    uint64_t    rx_time_ns;
+    uint8_t     buf[MBOX_SLOT_SIZE];
+} mbox_slot_t;
+
+/**
+ * wou_mbox_sub - a subscriber and its ring
+ * @tags:       WOU_MBOX_TAG(MT_*) bitmap
+ * @mask:       ring size - 1
+ * @head:       next slot to write; producer only
+ * @posted:     ... producer side counters
+ * @tail:       next slot to read; consumer only
+ * @drained:    ... consumer side counter
+ **/
+struct wou_mbox_sub {
+    uint32_t    tags;
+    uint32_t    mask;
+    mbox_slot_t *ring;
+
+    uint32_t    head __attribute__((aligned(CACHE_LINE)));
+    uint32_t    high_water;
+    uint64_t    posted;
+    uint64_t    dropped;
+
+    uint32_t    tail __attribute__((aligned(CACHE_LINE)));
+    uint64_t    drained;
+};
+
+wou_mbox_sub_t *board_mbox_subscribe (board_t* b, uint32_t tags, uint32_t depth)
+{
+    wou_mbox_sub_t *sub;
+    uint32_t    size;
+    int         i;
+
+    for (i = 0; i < WOU_MBOX_MAX_SUBS; i++) {
+        if (b->wou->mbox_subs[i] == NULL) {
+            break;
+        }
+    }
+    if (i == WOU_MBOX_MAX_SUBS) {
+        ERRP ("more than %d mailbox subscribers\n", WOU_MBOX_MAX_SUBS);
+        return NULL;
+    }
+    for (size = 2; size < depth; size <<= 1);
+    if (posix_memalign ((void **) &sub, CACHE_LINE, sizeof(wou_mbox_sub_t)) != 0) {
+        return NULL;
+    }
+    memset (sub, 0, sizeof(wou_mbox_sub_t));
+    sub->ring = (mbox_slot_t *) malloc (size * sizeof(mbox_slot_t));
+    if (sub->ring == NULL) {
+        free (sub);
+        return NULL;
+    }
+    sub->tags = tags;
+    sub->mask = size - 1;
+    __atomic_store_n (&(b->wou->mbox_subs[i]), sub, __ATOMIC_RELEASE);
+    return sub;
+}
+
+void board_mbox_unsubscribe (board_t* b, wou_mbox_sub_t *sub)
+{
+    int         i;
+
+    if (sub == NULL) {
+        return;
+    }
+    for (i = 0; i < WOU_MBOX_MAX_SUBS; i++) {
+        if (b->wou->mbox_subs[i] == sub) {
+            __atomic_store_n (&(b->wou->mbox_subs[i]), NULL, __ATOMIC_RELEASE);
+        }
+    }
+    free (sub->ring);
+    free (sub);
+}
+
+/**
+ * board_mbox_post - copy a mail to the rings subscribing its tag
+ *  called by wouf_parse() with buf_head[0] in (3, 254)
+ **/
+void board_mbox_post (board_t* b, const uint8_t *buf_head)
+{
+    wou_mbox_sub_t *sub;
+    mbox_slot_t *slot;
+    uint16_t    tag;
+    uint32_t    bit;
+    uint32_t    head;
+    uint32_t    pending;
+    int         i;
+
+    memcpy (&tag, buf_head + 2, sizeof(uint16_t));
+    bit = (tag < 32) ? ((uint32_t) 1 << tag) : 0;
+    for (i = 0; i < WOU_MBOX_MAX_SUBS; i++) {
+        sub = __atomic_load_n (&(b->wou->mbox_subs[i]), __ATOMIC_ACQUIRE);
+        if ((sub == NULL) || !((sub->tags & bit) || (sub->tags == WOU_MBOX_ALL))) {
+            continue;
+        }
+        head = sub->head;
+        pending = head - __atomic_load_n (&(sub->tail), __ATOMIC_ACQUIRE);
+        if (pending > sub->mask) {
+            __atomic_store_n (&(sub->dropped), sub->dropped + 1, __ATOMIC_RELAXED);
+            continue;
+        }
+        slot = &(sub->ring[head & sub->mask]);
+        slot->rx_time_ns = b->wou->rx_time_ns;
+        memcpy (slot->buf, buf_head, 1 + buf_head[0]);
+        __atomic_store_n (&(sub->head), head + 1, __ATOMIC_RELEASE);
+        __atomic_store_n (&(sub->posted), sub->posted + 1, __ATOMIC_RELAXED);
+        if (pending + 1 > sub->high_water) {
+            __atomic_store_n (&(sub->high_water), pending + 1, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+int wou_mbox_drain (wou_mbox_sub_t *sub, libwou_mail_fn fn, void *ctx, int max)
+{
+    mbox_slot_t *slot;
+    uint32_t    tail;
+    uint32_t    head;
+    uint32_t    n;
+    uint32_t    i;
+
+    tail = sub->tail;
+    head = __atomic_load_n (&(sub->head), __ATOMIC_ACQUIRE);
+    n = head - tail;
+    if ((max > 0) && (n > (uint32_t) max)) {
+        n = max;
+    }
+    for (i = 0; i < n; i++) {
+        slot = &(sub->ring[(tail + i) & sub->mask]);
+        fn (ctx, slot->buf, slot->rx_time_ns);
+    }
+    __atomic_store_n (&(sub->drained), sub->drained + n, __ATOMIC_RELAXED);
+    __atomic_store_n (&(sub->tail), tail + n, __ATOMIC_RELEASE);
+    return n;
+}
+
+void wou_mbox_stats (const wou_mbox_sub_t *sub, wou_mbox_stats_t *stats)
+{
+    stats->posted = __atomic_load_n (&(sub->posted), __ATOMIC_RELAXED);
+    stats->dropped = __atomic_load_n (&(sub->dropped), __ATOMIC_RELAXED);
+    stats->drained = __atomic_load_n (&(sub->drained), __ATOMIC_RELAXED);
+    stats->high_water = __atomic_load_n (&(sub->high_water), __ATOMIC_RELAXED);
+    stats->depth = sub->mask + 1;
+}
+
+// vim:sw=4:sts=4:et:
@@ -0,0 +1,219 @@
+/**
+ * param.c - host copy of motion and machine parameters
+ *
+ * wou_mot_param_set() and wou_mach_param_set() only update the host
+ * copy and mark changed entries dirty. wou_params_commit() uploads the
+ * dirty entries as one SYNC command stream (4 SYNC_DATA + SYNC_*_PARAM
+ * each), which board_sync_push() packs into as few WOU-Frames as
+ * possible, and fences once at the end.
+ *
+ * Copyright (C) 2009 Yishin Li <ysli@araisrobo.com>
+ **/
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <config.h>
+#ifdef HAVE_LIBFTD2XX
+#include <ftd2xx.h>     // from FTDI
+#else
+#ifdef HAVE_LIBFTDI
+#include <ftdi.h>       // from FTDI
+#endif  // HAVE_LIBFTDI
+#endif  // HAVE_LIBFTD2XX
+
+#include "wb_regs.h"
+#include "wou.h"
+#include "board.h"
+#include "sync_cmd.h"
+
+#define PARAM_BATCH     16                      // parameters per board_sync_push()
+
+/**
+ * wou_params - host copy of the parameters
+ * @mot:        motion parameters of each joint
+ * @mach:       machine parameters
+ * @mot_valid:  bitmap of mot[joint][] ever set
+ * @mot_dirty:  bitmap of mot[joint][] to upload
+ * @mach_valid: bitmap of mach[] ever set
+ * @mach_dirty: bitmap of mach[] to upload
+ **/
+struct wou_params {
+    uint32_t    mot[WOU_MAX_JOINTS][MAX_PARAM_ITEM];
+    uint32_t    mach[MACHINE_PARAM_ITEM];
+    uint32_t    mot_valid[WOU_MAX_JOINTS];
+    uint32_t    mot_dirty[WOU_MAX_JOINTS];
+    uint64_t    mach_valid;
+    uint64_t    mach_dirty;
+};
+
+typedef char mot_param_bitmap_fits[(MAX_PARAM_ITEM <= 32) ? 1 : -1];
+typedef char mach_param_bitmap_fits[(MACHINE_PARAM_ITEM <= 64) ? 1 : -1];
+
+static struct wou_params *params_get (board_t* b)
+{
+    if (b->wou->params == NULL) {
+        b->wou->params = (struct wou_params *) calloc (1, sizeof(struct wou_params));
+    }
+    return b->wou->params;
+}
+
+int wou_mot_param_set (wou_param_t *w_param, uint8_t joint, uint16_t addr,
+                       uint32_t val)
+{
+    struct wou_params *p;
+    uint32_t    bit;
+
+    if ((joint >= WOU_MAX_JOINTS) || (addr >= MAX_PARAM_ITEM)) {
+        return INVALID_DATA;
+    }
+    p = params_get (w_param->board);
+    if (p == NULL) {
+        return -ENOMEM;
+    }
+    bit = (uint32_t) 1 << addr;
+    if ((p->mot_valid[joint] & bit) && (p->mot[joint][addr] == val)) {
+        return 0;
+    }
+    p->mot[joint][addr] = val;
+    p->mot_valid[joint] |= bit;
+    p->mot_dirty[joint] |= bit;
+    return 0;
+}
+
+int wou_mach_param_set (wou_param_t *w_param, uint16_t addr, uint32_t val)
+{
+    struct wou_params *p;
+    uint64_t    bit;
+
+    if (addr >= MACHINE_PARAM_ITEM) {
+        return INVALID_DATA;
+    }
+    p = params_get (w_param->board);
+    if (p == NULL) {
+        return -ENOMEM;
+    }
+    bit = (uint64_t) 1 << addr;
+    if ((p->mach_valid & bit) && (p->mach[addr] == val)) {
+        return 0;
+    }
+    p->mach[addr] = val;
+    p->mach_valid |= bit;
+    p->mach_dirty |= bit;
+    return 0;
+}
+
+void wou_params_invalidate (wou_param_t *w_param)
+{
+    struct wou_params *p;
+    int         j;
+
+    p = w_param->board->wou->params;
+    if (p == NULL) {
+        return;
+    }
+    for (j = 0; j < WOU_MAX_JOINTS; j++) {
+        p->mot_dirty[j] = p->mot_valid[j];
+    }
+    p->mach_dirty = p->mach_valid;
+}
+
+/**
+ * board_params_size - size of the image of board_params_image()
+ **/
+size_t board_params_size (void)
+{
+    return sizeof(struct wou_params);
+}
+
+/**
+ * board_params_image - the host copy as a flat image, NULL if never set
+ **/
+const void *board_params_image (board_t* b)
+{
+    return b->wou->params;
+}
+
+/**
+ * board_params_load - replace the host copy with an image of 
+ *                     board_params_image(); everything valid becomes dirty
+ *  return 0 on success, -ENOMEM
+ **/
+int board_params_load (board_t* b, const void *image)
+{
+    struct wou_params *p;
+    int         j;
+
+    p = params_get (b);
+    if (p == NULL) {
+        return -ENOMEM;
+    }
+    memcpy (p, image, sizeof(struct wou_params));
+    for (j = 0; j < WOU_MAX_JOINTS; j++) {
+        p->mot_dirty[j] = p->mot_valid[j];
+    }
+    p->mach_dirty = p->mach_valid;
+    return 0;
+}
+
+int wou_params_commit (wou_param_t *w_param, wou_ticket_t *ticket)
+{
+    return board_params_commit (w_param->board, ticket);
+}
+
+/**
+ * board_params_commit - upload the dirty parameters, see wou_params_commit()
+ **/
+int board_params_commit (board_t* b, wou_ticket_t *ticket)
+{
+    struct wou_params *p;
+    wou_ticket_t fence;
+    uint16_t    cmds[PARAM_BATCH * SYNC_DATA_CMD_WORDS];
+    uint16_t    *c;
+    int         count;
+    int         j;
+    int         a;
+
+    p = b->wou->params;
+    count = 0;
+    c = cmds;
+    if (p) {
+        for (j = 0; j < WOU_MAX_JOINTS; j++) {
+            while (p->mot_dirty[j]) {
+                a = __builtin_ctz (p->mot_dirty[j]);
+                p->mot_dirty[j] &= p->mot_dirty[j] - 1;
+                c = board_sync_data_cmd (c, p->mot[j][a], SYNC_MOT_PARAM |
+                                PACK_MOT_PARAM_ADDR(a) | PACK_MOT_PARAM_ID(j));
+                count ++;
+                if (c == cmds + PARAM_BATCH * SYNC_DATA_CMD_WORDS) {
+                    board_sync_push (b, cmds, c - cmds);
+                    c = cmds;
+                }
+            }
+        }
+        while (p->mach_dirty) {
+            a = __builtin_ctzll (p->mach_dirty);
+            p->mach_dirty &= p->mach_dirty - 1;
+            c = board_sync_data_cmd (c, p->mach[a], SYNC_MACH_PARAM | PACK_MACH_PARAM_ADDR(a));
+            count ++;
+            if (c == cmds + PARAM_BATCH * SYNC_DATA_CMD_WORDS) {
+                board_sync_push (b, cmds, c - cmds);
+                c = cmds;
+            }
+        }
+        if (c != cmds) {
+            board_sync_push (b, cmds, c - cmds);
+        }
+    }
+    fence = board_fence (b);
+    if (ticket) {
+        *ticket = fence;
+    }
+    return count;
+}
+
+// vim:sw=4:sts=4:et:
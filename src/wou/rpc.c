@@ -0,0 +1,258 @@
+/**
+ * rpc.c - pipelined requests to the RISC firmware
+ *
+ * A request is a SYNC_USB_CMD (or whatever the caller pushed before)
+ * whose completion is a mail: the first mail of reply_tag with
+ * (payload word[reply_word] & reply_mask) == reply_value. The firmware
+ * serves SYNC commands in FIFO order and its replies carry no request
+ * ID, so a mail completes the oldest pending request it matches.
+ * Requests of different kinds match different replies and complete
+ * independently of each other.
+ *
+ * The table has WOU_RPC_MAX slots. An ID is (generation * WOU_RPC_MAX +
+ * slot), so it finds its slot, and tells whether the slot still holds
+ * its result. Everything runs in the thread pumping USB I/O: replies are
+ * matched in wouf_parse(), deadlines are checked in wou_recv().
+ *
+ * Copyright (C) 2009 Yishin Li <ysli@araisrobo.com>
+ **/
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <config.h>
+#ifdef HAVE_LIBFTD2XX
+#include <ftd2xx.h>     // from FTDI
+#else
+#ifdef HAVE_LIBFTDI
+#include <ftdi.h>       // from FTDI
+#endif  // HAVE_LIBFTDI
+#endif  // HAVE_LIBFTD2XX
+
+#include "wb_regs.h"
+#include "wou.h"
+#include "board.h"
+#include "mailtag.h"
+#include "sync_cmd.h"
+
+/* pending_tags and next_deadline of the pending requests */
+static void rpc_update (rpc_t *rpc)
+{
+    rpc_slot_t  *s;
+    int         i;
+
+    rpc->pending_tags = 0;
+    rpc->next_deadline = UINT64_MAX;
+    for (i = 0; i < WOU_RPC_MAX; i++) {
+        s = &(rpc->slot[i]);
+        if (s->state != RPC_PENDING) {
+            continue;
+        }
+        rpc->pending_tags |= (uint32_t) 1 << s->req.reply_tag;
+        if (s->deadline < rpc->next_deadline) {
+            rpc->next_deadline = s->deadline;
+        }
+    }
+}
+
+static void rpc_done (rpc_t *rpc, rpc_slot_t *s, int status,
+                      const uint8_t *reply, uint32_t size, uint64_t t)
+{
+    wou_rpc_stats_t *st;
+    uint64_t    latency_ns;
+
+    st = &(rpc->stats);
+    latency_ns = (t > s->t_issue) ? (t - s->t_issue) : 0;
+    s->state = RPC_DONE;
+    s->status = status;
+    rpc->nr_pending --;
+    if (status == 0) {
+        st->completed ++;
+        st->latency_sum_ns += latency_ns;
+        if ((st->latency_min_ns == 0) || (latency_ns < st->latency_min_ns)) {
+            st->latency_min_ns = latency_ns;
+        }
+        if (latency_ns > st->latency_max_ns) {
+            st->latency_max_ns = latency_ns;
+        }
+    } else if (status == -ETIMEDOUT) {
+        st->timeouts ++;
+    } else {
+        st->cancelled ++;
+    }
+    if (s->cb) {
+        s->cb (s->ctx, status, s->id, reply, size, latency_ns);
+    }
+}
+
+/**
+ * board_rpc_call - issue a request and add it to the table
+ *  return the request ID (> 0), -EAGAIN if WOU_RPC_MAX requests are
+ *         pending, INVALID_DATA for a bad reply_tag
+ **/
+int board_rpc_call (board_t* b, const wou_rpc_req_t *req,
+                    libwou_rpc_cb_fn cb, void *ctx)
+{
+    rpc_t       *rpc;
+    rpc_slot_t  *s;
+    uint16_t    sync_cmd[SYNC_DATA_CMD_WORDS];
+    int         id;
+    int         i;
+
+    rpc = &(b->wou->rpc);
+    if (req->reply_tag >= WOU_MAIL_NR_TAGS) {
+        return INVALID_DATA;
+    }
+    for (i = 0; i < WOU_RPC_MAX; i++) {
+        if (rpc->slot[i].state != RPC_PENDING) {
+            break;
+        }
+    }
+    if (i == WOU_RPC_MAX) {
+        return -EAGAIN;
+    }
+    s = &(rpc->slot[i]);
+    s->gen ++;
+    if (((uint64_t) s->gen * WOU_RPC_MAX + i) > INT32_MAX) {
+        s->gen = 1;
+    }
+    s->id = s->gen * WOU_RPC_MAX + i;
+    id = s->id;     // a callback may reuse the slot during the fence
+    s->req = *req;
+    s->cb = cb;
+    s->ctx = ctx;
+    s->seq = rpc->seq ++;
+    s->status = -EINPROGRESS;
+    s->state = RPC_PENDING;
+    s->t_issue = wou_time_ns ();
+    s->deadline = (req->timeout_us == 0) ? UINT64_MAX :
+                  (s->t_issue + (uint64_t) req->timeout_us * 1000);
+
+    rpc->nr_pending ++;
+    rpc->stats.issued ++;
+    if (rpc->nr_pending > rpc->stats.max_in_flight) {
+        rpc->stats.max_in_flight = rpc->nr_pending;
+    }
+    rpc->pending_tags |= (uint32_t) 1 << req->reply_tag;
+    if (s->deadline < rpc->next_deadline) {
+        rpc->next_deadline = s->deadline;
+    }
+
+    // the fence pumps USB I/O: the reply may be parsed before it returns
+    if (req->type) {
+        // same as wou_sync_usb_cmd()
+        board_sync_data_cmd (sync_cmd, req->val,
+                             SYNC_USB_CMD | PACK_USB_CMD_TYPE(req->type));
+        board_sync_push (b, sync_cmd, SYNC_DATA_CMD_WORDS);
+        board_fence (b);
+    }
+    return id;
+}
+
+/**
+ * board_rpc_mail - complete the oldest pending request the mail matches
+ *  called by wouf_parse() while requests wait for the tag of the mail
+ **/
+void board_rpc_mail (board_t* b, const uint8_t *buf_head)
+{
+    rpc_t       *rpc;
+    rpc_slot_t  *s;
+    rpc_slot_t  *oldest;
+    uint16_t    tag;
+    uint32_t    size;
+    uint32_t    word;
+    int         i;
+
+    rpc = &(b->wou->rpc);
+    tag = mail_tag (buf_head);
+    if ((tag >= WOU_MAIL_NR_TAGS) || !(rpc->pending_tags & ((uint32_t) 1 << tag))) {
+        return;
+    }
+    size = MAIL_PLOAD_SIZE(buf_head);
+    oldest = NULL;
+    for (i = 0; i < WOU_RPC_MAX; i++) {
+        s = &(rpc->slot[i]);
+        if ((s->state != RPC_PENDING) || (s->req.reply_tag != tag) ||
+            ((s->req.reply_word + 1) * sizeof(uint32_t) > size)) {
+            continue;
+        }
+        memcpy (&word, buf_head + MAIL_HDR_SIZE + s->req.reply_word * sizeof(uint32_t),
+                sizeof(uint32_t));
+        if (((word & s->req.reply_mask) == s->req.reply_value) &&
+            ((oldest == NULL) || (s->seq < oldest->seq))) {
+            oldest = s;
+        }
+    }
+    if (oldest == NULL) {
+        rpc->stats.unmatched ++;
+        return;
+    }
+    rpc_done (rpc, oldest, 0, buf_head + MAIL_HDR_SIZE, size, b->wou->rx_time_ns);
+    rpc_update (rpc);
+}
+
+/**
+ * board_rpc_expire - fail the requests past their deadline with -ETIMEDOUT
+ *  called by wou_recv() while requests are pending
+ **/
+void board_rpc_expire (board_t* b)
+{
+    rpc_t       *rpc;
+    rpc_slot_t  *s;
+    uint64_t    now;
+    int         i;
+
+    rpc = &(b->wou->rpc);
+    now = wou_time_ns ();
+    if (now < rpc->next_deadline) {
+        return;
+    }
+    for (i = 0; i < WOU_RPC_MAX; i++) {
+        s = &(rpc->slot[i]);
+        if ((s->state == RPC_PENDING) && (s->deadline <= now)) {
+            rpc_done (rpc, s, -ETIMEDOUT, NULL, 0, now);
+        }
+    }
+    rpc_update (rpc);
+}
+
+/**
+ * board_rpc_cancel - fail all pending requests with -ECANCELED
+ **/
+void board_rpc_cancel (board_t* b)
+{
+    rpc_t       *rpc;
+    int         i;
+
+    rpc = &(b->wou->rpc);
+    for (i = 0; i < WOU_RPC_MAX; i++) {
+        if (rpc->slot[i].state == RPC_PENDING) {
+            rpc_done (rpc, &(rpc->slot[i]), -ECANCELED, NULL, 0, wou_time_ns ());
+        }
+    }
+    rpc_update (rpc);
+}
+
+/**
+ * board_rpc_status - status of request id
+ *  return -EINPROGRESS while pending, then the status it completed with;
+ *         -ENOENT if its slot has been reused or id is invalid
+ **/
+int board_rpc_status (board_t* b, int id)
+{
+    rpc_slot_t  *s;
+
+    if (id <= 0) {
+        return -ENOENT;
+    }
+    s = &(b->wou->rpc.slot[id % WOU_RPC_MAX]);
+    if ((s->id != (uint32_t) id) || (s->state == RPC_FREE)) {
+        return -ENOENT;
+    }
+    return s->status;
+}
+
+// vim:sw=4:sts=4:et:
@@ -0,0 +1,316 @@
+/**
+ * sfifo.c - host model of the SYNC command FIFO
+ *
+ * The FPGA stalls the WB_WRITE to JCMD_SYNC_CMD while SFIFO is full,
+ * which the host only sees as slow ACKs and retransmits. Instead the
+ * host keeps an estimate of the words in SFIFO:
+ *
+ *   level = pushed - consumed
+ *
+ * pushed counts every word of board_sync_push(), sent or not yet sent.
+ * The FPGA cannot have taken more words than it received, so consumed
+ * is an estimate est capped at acked, the words of the acknowledged
+ * woufs (board_sfifo_track() keeps the pushed count of each wouf).
+ * est is updated from
+ *   - bp_tick of MT_MOTION_STATUS and MT_TICK mails: the firmware takes
+ *     words_per_bp words each base period while there are any;
+ *   - a level register, if the bitfile has one: a read issued after
+ *     pushed words P that returns L means est = P - L, since the read
+ *     is served after the words before it entered SFIFO (which also
+ *     proves that the P words are received);
+ *   - ERROR_SFIFO_EMPTY: est = acked, everything received is taken.
+ * The bp_tick estimate is capped at acked on every tick, so while ACKs
+ * lag it stays behind the firmware and the producer is throttled early.
+ * It still assumes words_per_bp words taken on every tick, and runs
+ * ahead of the firmware if it takes fewer; the level register and
+ * underruns correct that.
+ *
+ * board_sync_push() waits for credits (depth - level) before pushing.
+ * The owner is warned when level drops below low_water, and on underrun.
+ *
+ * Copyright (C) 2009 Yishin Li <ysli@araisrobo.com>
+ **/
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <config.h>
+#ifdef HAVE_LIBFTD2XX
+#include <ftd2xx.h>     // from FTDI
+#else
+#ifdef HAVE_LIBFTDI
+#include <ftdi.h>       // from FTDI
+#endif  // HAVE_LIBFTDI
+#endif  // HAVE_LIBFTD2XX
+
+#include "wb_regs.h"
+#include "wou.h"
+#include "board.h"
+#include "mailtag.h"
+
+static uint32_t sfifo_level (const sfifo_t *f)
+{
+    return (uint32_t) (f->pushed - f->consumed);
+}
+
+/* move acked forward to the woufs acknowledged so far */
+static void sfifo_acked (board_t* b)
+{
+    sfifo_t     *f;
+    uint32_t    i;
+
+    f = &(b->wou->sfifo);
+    while (f->tk_head != f->tk_tail) {
+        i = f->tk_head % NR_SFIFO_TK;
+        if (!board_is_acked (b, f->tk[i])) {
+            break;
+        }
+        if (f->tk_pushed[i] > f->acked) {
+            f->acked = f->tk_pushed[i];
+        }
+        f->tk_head ++;
+    }
+}
+
+/* move consumed forward to est, never past acked, and check low_water */
+static void sfifo_update (board_t* b)
+{
+    sfifo_t     *f;
+    uint64_t    consumed;
+    uint32_t    level;
+
+    f = &(b->wou->sfifo);
+    sfifo_acked (b);
+    consumed = (f->est < f->acked) ? f->est : f->acked;
+    if (consumed > f->consumed) {
+        f->consumed = consumed;
+    }
+    f->stats.consumed = f->consumed;
+    level = sfifo_level (f);
+    if (level >= f->cfg.low_water) {
+        f->low_armed = 1;
+    } else if (f->low_armed) {
+        f->low_armed = 0;
+        f->stats.low_warnings ++;
+        if (f->cb) {
+            f->cb (f->ctx, WOU_SFIFO_LOW, level);
+        }
+    }
+}
+
+/**
+ * sfifo_level_cb - response of the level register read by
+ *                  board_sfifo_reserve()
+ **/
+static void sfifo_level_cb (void *ctx, int status, const uint8_t *data,
+                            uint16_t dsize, uint64_t rx_time_ns)
+{
+    board_t     *b;
+    sfifo_t     *f;
+    uint64_t    pushed;
+    uint32_t    level;
+
+    (void) rx_time_ns;
+    b = ctx;
+    f = &(b->wou->sfifo);
+    pushed = f->rd_pushed[f->rd_head % NR_SFIFO_RD];
+    f->rd_head ++;
+    if (status != 0) {
+        return;
+    }
+    level = 0;
+    memcpy (&level, data, dsize);
+    f->stats.level_reads ++;
+    if (pushed > f->acked) {
+        f->acked = pushed;
+    }
+    if ((pushed >= level) && ((pushed - level) > f->est)) {
+        f->est = pushed - level;
+    }
+    sfifo_update (b);
+}
+
+static int sfifo_room_cond (void *ctx)
+{
+    board_t     *b;
+    sfifo_t     *f;
+
+    b = ctx;
+    f = &(b->wou->sfifo);
+    sfifo_update (b);   // ACKs may have come in
+    return ((sfifo_level (f) + f->want) <= f->cfg.depth) || (sfifo_level (f) == 0);
+}
+
+/**
+ * board_sfifo_reserve - wait for credits of n words, then count them
+ *                       as pushed; a level read goes ahead of them
+ *  called by board_sync_push() while the model is configured
+ **/
+void board_sfifo_reserve (board_t* b, int n)
+{
+    sfifo_t     *f;
+    uint64_t    t;
+    int         ret;
+
+    f = &(b->wou->sfifo);
+    f->want = n;
+    if (!f->waiting && !sfifo_room_cond (b)) {
+        // get the words already pushed going before waiting for them
+        board_fence (b);
+        f->waiting = 1;
+        t = wou_time_ns ();
+        ret = board_wait_until (b, sfifo_room_cond, b, (int64_t) f->cfg.max_wait_us * 1000);
+        t = wou_time_ns () - t;
+        f->waiting = 0;
+        f->stats.throttles ++;
+        f->stats.throttle_ns += t;
+        if (ret != 0) {
+            f->stats.throttle_timeouts ++;
+        }
+    }
+    if (f->cfg.level_addr && !f->waiting &&
+        ((f->rd_tail - f->rd_head) < NR_SFIFO_RD)) {
+        t = wou_time_ns ();
+        if (t >= f->t_level) {
+            f->t_level = t + (uint64_t) f->cfg.level_period_us * 1000;
+            // only the words pushed so far are ahead of the read in SFIFO
+            f->rd_pushed[f->rd_tail % NR_SFIFO_RD] = f->pushed;
+            f->waiting = 1;
+            ret = board_read_async (b, f->cfg.level_addr, f->cfg.level_size,
+                                    sfifo_level_cb, b);
+            f->waiting = 0;
+            if (ret == 0) {
+                f->rd_tail ++;
+            }
+        }
+    }
+    f->pushed += n;
+    f->stats.pushed = f->pushed;
+}
+
+/**
+ * board_sfifo_track - note the wouf holding the words pushed so far
+ *  called by board_sync_push() after the words are in the current wouf
+ **/
+void board_sfifo_track (board_t* b)
+{
+    sfifo_t     *f;
+    wou_ticket_t ticket;
+    uint32_t    i;
+
+    f = &(b->wou->sfifo);
+    ticket.epoch = b->wou->tid_epoch;
+    ticket.tid = b->wou->tid;
+    if (f->tk_head != f->tk_tail) {
+        i = (f->tk_tail - 1) % NR_SFIFO_TK;
+        if (((f->tk[i].epoch == ticket.epoch) && (f->tk[i].tid == ticket.tid)) ||
+            ((f->tk_tail - f->tk_head) == NR_SFIFO_TK)) {
+            // same wouf, or no room: a later wouf only delays acked
+            f->tk[i] = ticket;
+            f->tk_pushed[i] = f->pushed;
+            return;
+        }
+    }
+    i = f->tk_tail % NR_SFIFO_TK;
+    f->tk[i] = ticket;
+    f->tk_pushed[i] = f->pushed;
+    f->tk_tail ++;
+}
+
+/**
+ * board_sfifo_mail - update the model from bp_tick and ERROR_SFIFO_EMPTY
+ *  called by wouf_parse() while the model is configured
+ **/
+void board_sfifo_mail (board_t* b, const uint8_t *buf_head)
+{
+    sfifo_t     *f;
+    uint16_t    tag;
+    uint32_t    bp_tick;
+    uint32_t    code;
+
+    f = &(b->wou->sfifo);
+    tag = mail_tag (buf_head);
+    if (((tag == MT_MOTION_STATUS) || (tag == MT_TICK)) &&
+        (MAIL_PLOAD_SIZE(buf_head) >= (int) sizeof(mail_tick_t))) {
+        bp_tick = ((const mail_tick_t *) (buf_head + MAIL_HDR_SIZE))->bp_tick;
+        if (f->tick_valid && f->cfg.words_per_bp) {
+            // the firmware does not take words it has not received yet
+            sfifo_acked (b);
+            f->est += (uint64_t) (uint32_t) (bp_tick - f->bp_tick) * f->cfg.words_per_bp;
+            if (f->est > f->acked) {
+                f->est = f->acked;
+            }
+        }
+        f->bp_tick = bp_tick;
+        f->tick_valid = 1;
+    } else if ((tag == MT_ERROR_CODE) &&
+               (MAIL_PLOAD_SIZE(buf_head) >= (int) sizeof(mail_error_code_t))) {
+        code = ((const mail_error_code_t *) (buf_head + MAIL_HDR_SIZE))->code;
+        if (code == ERROR_SFIFO_EMPTY) {
+            sfifo_acked (b);
+            if (f->acked > f->est) {
+                f->est = f->acked;
+            }
+            f->stats.underruns ++;
+            if (f->cb) {
+                f->cb (f->ctx, WOU_SFIFO_UNDERRUN, 0);
+            }
+        }
+    }
+    sfifo_update (b);
+}
+
+/**
+ * board_sfifo_config - (re)start the model with an empty SFIFO
+ *  return 0 on success, INVALID_DATA for a bad level register
+ **/
+int board_sfifo_config (board_t* b, const wou_sfifo_cfg_t *cfg,
+                        libwou_sfifo_cb_fn cb, void *ctx)
+{
+    sfifo_t     *f;
+
+    f = &(b->wou->sfifo);
+    if (cfg && cfg->depth && cfg->level_addr &&
+        ((cfg->level_size == 0) || (cfg->level_size > sizeof(uint32_t)))) {
+        return INVALID_DATA;
+    }
+    if (f->rd_tail != f->rd_head) {
+        // sfifo_level_cb() of pending reads still pops rd_pushed[]
+        return -EBUSY;
+    }
+    memset (f, 0, sizeof(sfifo_t));
+    if (cfg && cfg->depth) {
+        f->cfg = *cfg;
+        f->cb = cb;
+        f->ctx = ctx;
+        f->low_armed = 1;
+    }
+    return 0;
+}
+
+uint32_t board_sfifo_credits (board_t* b)
+{
+    sfifo_t     *f;
+
+    f = &(b->wou->sfifo);
+    sfifo_update (b);
+    if (sfifo_level (f) >= f->cfg.depth) {
+        return 0;
+    }
+    return f->cfg.depth - sfifo_level (f);
+}
+
+void board_sfifo_stats (board_t* b, wou_sfifo_stats_t *stats)
+{
+    sfifo_t     *f;
+
+    f = &(b->wou->sfifo);
+    sfifo_update (b);
+    *stats = f->stats;
+    stats->level = sfifo_level (f);
+}
+
+// vim:sw=4:sts=4:et:
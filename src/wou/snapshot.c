@@ -0,0 +1,330 @@
+/**
+ * snapshot.c - warm restart from a snapshot of the board configuration
+ *
+ * Every host write to a write-only PLAIN register of WB_REG_TABLE (pulse
+ * and encoder types, max PWM, JCMD_CTRL, ...) is kept in board->shadow[].
+ * board_snapshot_save() writes the shadow and the parameter tables of
+ * param.c to a flat file:
+ *
+ *   snap_hdr_t | shadow[SHADOW_SIZE] | shadow_valid[SHADOW_SIZE] | pad to 8 |
+ *   the parameter image of board_params_image()
+ *
+ * board_restore() maps the file and replays it as one board_cmdv() batch
+ * plus the packed SYNC parameter stream, instead of the one register per
+ * wou_cmd()/wou_flush() setup sequence. The header carries a hash of the
+ * register table and of the parameter dimensions, so a snapshot whose
+ * bytes would land in other registers or parameters is rejected.
+ *
+ * Copyright (C) 2009 Yishin Li <ysli@araisrobo.com>
+ **/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <config.h>
+#ifdef HAVE_LIBFTD2XX
+#include <ftd2xx.h>     // from FTDI
+#else
+#ifdef HAVE_LIBFTDI
+#include <ftdi.h>       // from FTDI
+#endif  // HAVE_LIBFTDI
+#endif  // HAVE_LIBFTD2XX
+
+#include "wb_regs.h"
+#include "wou.h"
+#include "board.h"
+#include "sync_cmd.h"
+
+#define SNAP_MAGIC      0x504E5357  // "WSNP"
+#define SNAP_VERSION    2
+#define SNAP_F_PARAMS   0x0001      // the parameter image is valid
+
+/**
+ * snap_hdr_t - head of a snapshot file
+ * @shadow_size:    SHADOW_SIZE of the writer
+ * @params_size:    board_params_size() of the writer
+ * @layout:         snap_layout of the writer
+ **/
+typedef struct {
+    uint32_t    magic;
+    uint16_t    version;
+    uint16_t    flags;
+    uint32_t    shadow_size;
+    uint32_t    params_size;
+    uint64_t    layout;
+} snap_hdr_t;
+
+#define SNAP_PARAMS_OFFSET  ((sizeof(snap_hdr_t) + 2 * SHADOW_SIZE + 7) & ~7)
+
+typedef struct {
+    uint16_t    addr;
+    uint16_t    size;
+    uint16_t    offset;
+} shadow_reg_t;
+
+#define SHADOW_REG(NAME, ADDR, WIDTH, COUNT, ACCESS, KIND)              \
+    { (ADDR), SHADOW_BYTES(WIDTH, COUNT, ACCESS, KIND), SHADOW_OFF_##NAME },
+static const shadow_reg_t shadow_regs[] = {
+    WB_REG_TABLE(SHADOW_REG)
+};
+#define NR_SHADOW_REGS  (sizeof(shadow_regs) / sizeof(shadow_regs[0]))
+
+/* the shadowed registers of shadow_regs[], and [lo, hi) of their addresses */
+static const shadow_reg_t *shadow_live[NR_SHADOW_REGS];
+static uint32_t     nr_shadow_live;
+static uint32_t     shadow_lo;
+static uint32_t     shadow_hi;
+static uint64_t     snap_layout;
+static pthread_once_t shadow_once = PTHREAD_ONCE_INIT;
+
+static void shadow_index (void)
+{
+    const shadow_reg_t *r;
+    uint16_t    layout[3 * NR_SHADOW_REGS + 3];
+    uint32_t    i;
+
+    shadow_lo = WB_REG_SIZE;
+    shadow_hi = 0;
+    for (r = shadow_regs; r < shadow_regs + NR_SHADOW_REGS; r++) {
+        if (r->size == 0) {
+            continue;
+        }
+        shadow_live[nr_shadow_live ++] = r;
+        if (r->addr < shadow_lo) {
+            shadow_lo = r->addr;
+        }
+        if ((uint32_t) r->addr + r->size > shadow_hi) {
+            shadow_hi = (uint32_t) r->addr + r->size;
+        }
+    }
+
+    // {addr, size, offset} of every register, then the parameter tables
+    i = 0;
+    for (r = shadow_regs; r < shadow_regs + NR_SHADOW_REGS; r++) {
+        layout[i++] = r->addr;
+        layout[i++] = r->size;
+        layout[i++] = r->offset;
+    }
+    layout[i++] = WOU_MAX_JOINTS;
+    layout[i++] = MAX_PARAM_ITEM;
+    layout[i++] = MACHINE_PARAM_ITEM;
+    snap_layout = wou_fnv1a ((const uint8_t *) layout, sizeof(layout));
+}
+
+/**
+ * board_shadow_init - index the shadowed registers; called by board_init()
+ **/
+void board_shadow_init (void)
+{
+    pthread_once (&shadow_once, shadow_index);
+}
+
+/**
+ * board_shadow_wr - keep the bytes of a host write which fall into
+ *                   shadowed registers
+ **/
+void board_shadow_wr (board_t* b, uint16_t wb_addr, uint16_t dsize, const uint8_t *buf)
+{
+    const shadow_reg_t *r;
+    uint32_t    lo;
+    uint32_t    hi;
+    uint32_t    i;
+
+    if (((uint32_t) wb_addr >= shadow_hi) || ((uint32_t) wb_addr + dsize <= shadow_lo)) {
+        return;
+    }
+    for (i = 0; i < nr_shadow_live; i++) {
+        r = shadow_live[i];
+        lo = (wb_addr > r->addr) ? wb_addr : r->addr;
+        hi = ((uint32_t) wb_addr + dsize < (uint32_t) r->addr + r->size) ?
+             ((uint32_t) wb_addr + dsize) : ((uint32_t) r->addr + r->size);
+        if (lo < hi) {
+            memcpy (b->shadow + r->offset + (lo - r->addr), buf + (lo - wb_addr), hi - lo);
+            memset (b->shadow_valid + r->offset + (lo - r->addr), 1, hi - lo);
+        }
+    }
+}
+
+/**
+ * board_snapshot_save - write the shadow and the parameters to path
+ *  the file is replaced atomically
+ *  return 0 on success, -errno on failure
+ **/
+int board_snapshot_save (board_t* b, const char *path)
+{
+    static const uint8_t pad[8];
+    char            tmp[272];
+    snap_hdr_t      hdr;
+    const void      *params;
+    void            *zero;
+    FILE            *fp;
+    size_t          n;
+    int             ret;
+
+    params = board_params_image (b);
+    zero = NULL;
+    if (params == NULL) {
+        params = zero = calloc (1, board_params_size ());
+        if (zero == NULL) {
+            return -ENOMEM;
+        }
+    }
+    hdr.magic = SNAP_MAGIC;
+    hdr.version = SNAP_VERSION;
+    hdr.flags = zero ? 0 : SNAP_F_PARAMS;
+    hdr.shadow_size = SHADOW_SIZE;
+    hdr.params_size = board_params_size ();
+    board_shadow_init ();
+    hdr.layout = snap_layout;
+
+    snprintf (tmp, sizeof(tmp), "%s.%d", path, (int) getpid ());
+    fp = fopen (tmp, "wb");
+    if (fp == NULL) {
+        ret = -errno;
+        ERRP ("%s: %s\n", tmp, strerror(errno));
+        free (zero);
+        return ret;
+    }
+    n = fwrite (&hdr, sizeof(hdr), 1, fp);
+    n += fwrite (b->shadow, SHADOW_SIZE, 1, fp);
+    n += fwrite (b->shadow_valid, SHADOW_SIZE, 1, fp);
+    fwrite (pad, SNAP_PARAMS_OFFSET - sizeof(hdr) - 2 * SHADOW_SIZE, 1, fp);
+    n += fwrite (params, hdr.params_size, 1, fp);
+    free (zero);
+    ret = 0;
+    errno = 0;
+    if ((fclose (fp) != 0) || (n != 4) || (rename (tmp, path) != 0)) {
+        ret = errno ? -errno : -EIO;
+        ERRP ("%s: %s\n", path, strerror(-ret));
+        unlink (tmp);
+    }
+    return ret;
+}
+
+/* one WB_WR_CMD per run of valid bytes in the shadow of r */
+static int shadow_ops (const shadow_reg_t *r, const uint8_t *data,
+                       const uint8_t *valid, wou_op_t *ops)
+{
+    int         n;
+    int         i;
+    int         j;
+
+    n = 0;
+    for (i = 0; i < r->size; i = j) {
+        if (!valid[r->offset + i]) {
+            j = i + 1;
+            continue;
+        }
+        for (j = i; (j < r->size) && valid[r->offset + j]; j++);
+        ops[n].func = WB_WR_CMD;
+        ops[n].wb_addr = r->addr + i;
+        ops[n].dsize = j - i;
+        ops[n].data = data + r->offset + i;
+        n ++;
+    }
+    return n;
+}
+
+/**
+ * board_restore - replay a snapshot of board_snapshot_save()
+ *  The registers go first, in WB_REG_TABLE order, then the parameters;
+ *  JCMD_CTRL goes last so SSIF is enabled on a configured board.
+ *  GPIO_SOFT_RST and GPIO_RECONFIG are never replayed.
+ *  Load the RISC image before, as OR32_CTRL is replayed as well.
+ *  return 0 on success, INVALID_DATA if the snapshot does not match this
+ *         library, -errno on failure
+ **/
+int board_restore (board_t* b, const char *path, wou_ticket_t *ticket)
+{
+    const shadow_reg_t *r;
+    const shadow_reg_t *ctrl;
+    const snap_hdr_t *hdr;
+    const uint8_t   *map;
+    const uint8_t   *valid;
+    uint8_t         data[SHADOW_SIZE];
+    wou_op_t        ops[SHADOW_SIZE];
+    struct stat     st;
+    int             fd;
+    int             n;
+    int             ret;
+
+    fd = open (path, O_RDONLY);
+    if (fd < 0) {
+        ret = -errno;
+        ERRP ("%s: %s\n", path, strerror(errno));
+        return ret;
+    }
+    if (fstat (fd, &st) != 0) {
+        ret = -errno;
+        close (fd);
+        return ret;
+    }
+    if ((size_t) st.st_size < SNAP_PARAMS_OFFSET + board_params_size ()) {
+        close (fd);
+        ERRP ("%s: not a snapshot of this library\n", path);
+        return INVALID_DATA;
+    }
+    map = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+    if (map == MAP_FAILED) {
+        ret = -errno;
+        ERRP ("%s: %s\n", path, strerror(errno));
+        return ret;
+    }
+
+    hdr = (const snap_hdr_t *) map;
+    board_shadow_init ();
+    if ((hdr->magic != SNAP_MAGIC) || (hdr->version != SNAP_VERSION) ||
+        (hdr->shadow_size != SHADOW_SIZE) ||
+        (hdr->params_size != board_params_size ()) ||
+        (hdr->layout != snap_layout)) {
+        munmap ((void *) map, st.st_size);
+        ERRP ("%s: not a snapshot of this library\n", path);
+        return INVALID_DATA;
+    }
+    memcpy (data, map + sizeof(snap_hdr_t), SHADOW_SIZE);
+    valid = map + sizeof(snap_hdr_t) + SHADOW_SIZE;
+    data[SHADOW_OFF_GPIO_SYSTEM] &= ~(GPIO_SOFT_RST | GPIO_RECONFIG);
+
+    n = 0;
+    ctrl = NULL;
+    for (r = shadow_regs; r < shadow_regs + NR_SHADOW_REGS; r++) {
+        if (r->addr == (JCMD_BASE | JCMD_CTRL)) {
+            ctrl = r;
+        } else {
+            n += shadow_ops (r, data, valid, ops + n);
+        }
+    }
+    ret = board_cmdv (b, ops, n);
+    if ((ret == 0) && (hdr->flags & SNAP_F_PARAMS)) {
+        ret = board_params_load (b, map + SNAP_PARAMS_OFFSET);
+        if (ret == 0) {
+            n = board_params_commit (b, NULL);
+            if (n < 0) {
+                ret = n;
+            }
+        }
+    }
+    if ((ret == 0) && ctrl) {
+        n = shadow_ops (ctrl, data, valid, ops);
+        ret = board_cmdv (b, ops, n);
+    }
+    munmap ((void *) map, st.st_size);
+
+    if (ticket) {
+        *ticket = board_fence (b);
+    } else {
+        board_fence (b);
+    }
+    return ret;
+}
+
+// vim:sw=4:sts=4:et:
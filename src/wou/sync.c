@@ -0,0 +1,374 @@
+/**
+ * sync.c - SYNC command stream builder
+ *
+ * SYNC commands are 16-bit words pushed into the JCMD FIFO through
+ * JCMD_SYNC_CMD, which takes up to SYNC_CMD_MAX bytes per write.
+ * Instead of one [WOU] packet per command, board_sync_push() keeps
+ * extending the trailing JCMD_SYNC_CMD packet of the current wouf.
+ * Other packets appended in between close it, so the FIFO order
+ * always follows the call order.
+ *
+ * Copyright (C) 2009 Yishin Li <ysli@araisrobo.com>
+ **/
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <sys/param.h>  // for MIN() and MAX()
+
+#include <config.h>
+#ifdef HAVE_LIBFTD2XX
+#include <ftd2xx.h>     // from FTDI
+#else
+#ifdef HAVE_LIBFTDI
+#include <ftdi.h>       // from FTDI
+#endif  // HAVE_LIBFTDI
+#endif  // HAVE_LIBFTD2XX
+
+#include "wb_regs.h"
+#include "wou.h"
+#include "board.h"
+#include "sync_cmd.h"
+
+/**
+ * sync_pkt_open - size of the trailing JCMD_SYNC_CMD packet which could
+ *                 take more words; -1 if there's none
+ **/
+static int sync_pkt_open (const wouf_t *wou_frame_, int pkt)
+{
+    uint16_t    wb_addr;
+    int         dsize;
+
+    if ((pkt < WOUF_INIT_SIZE) || (pkt + WOU_HDR_SIZE > wou_frame_->fsize)) {
+        return -1;
+    }
+    if ((wou_frame_->buf[pkt] & WB_WR_CMD) == 0) {
+        return -1;
+    }
+    dsize = wou_frame_->buf[pkt] & 0x7F;
+    memcpy (&wb_addr, wou_frame_->buf + pkt + 1, WB_ADDR_SIZE);
+    if ((wb_addr != (JCMD_BASE | JCMD_SYNC_CMD)) ||
+        ((pkt + WOU_HDR_SIZE + dsize) != wou_frame_->fsize) ||
+        (dsize >= SYNC_CMD_MAX)) {
+        return -1;
+    }
+    return dsize;
+}
+
+/**
+ * board_sync_push - push n SYNC commands
+ *  waits for SFIFO credits first if wou_sfifo_config() is set, see sfifo.c
+ **/
+void board_sync_push (board_t* b, const uint16_t *cmds, int n)
+{
+    wouf_t      *wou_frame_;
+    int         dsize;
+    int         room;
+    int         words;
+    uint16_t    wb_addr;
+
+    if (b->wou->sfifo.cfg.depth) {
+        board_sfifo_reserve (b, n);
+    }
+    while (n > 0) {
+        wou_frame_ = &(b->wou->woufs[b->wou->clock]);
+        room = MAX_PSIZE - (wou_frame_->fsize - WOUF_HDR_SIZE);
+        dsize = sync_pkt_open (wou_frame_, b->wou->sync_pkt);
+        if (dsize < 0) {
+            // open a new JCMD_SYNC_CMD packet
+            if (room < (WOU_HDR_SIZE + (int) sizeof(uint16_t))) {
+                wou_eof_wait (b, TYP_WOUF, -1);
+                continue;
+            }
+            b->wou->sync_pkt = wou_frame_->fsize;
+            wb_addr = JCMD_BASE | JCMD_SYNC_CMD;
+            wou_frame_->buf[wou_frame_->fsize] = WB_WR_CMD;
+            memcpy (wou_frame_->buf + wou_frame_->fsize + 1, &wb_addr, WB_ADDR_SIZE);
+            wou_frame_->fsize += WOU_HDR_SIZE;
+            room -= WOU_HDR_SIZE;
+            dsize = 0;
+        }
+        words = MIN(n, (SYNC_CMD_MAX - dsize) / (int) sizeof(uint16_t));
+        words = MIN(words, room / (int) sizeof(uint16_t));
+        if (words == 0) {
+            wou_eof_wait (b, TYP_WOUF, -1);
+            continue;
+        }
+        memcpy (wou_frame_->buf + wou_frame_->fsize, cmds, words * sizeof(uint16_t));
+        wou_frame_->fsize += words * sizeof(uint16_t);
+        dsize += words * sizeof(uint16_t);
+        wou_frame_->buf[b->wou->sync_pkt] = WB_WR_CMD | dsize;
+        cmds += words;
+        n -= words;
+    }
+    if (b->wou->sfifo.cfg.depth) {
+        board_sfifo_track (b);
+    }
+}
+
+/**
+ * wou_sync_* - typed SYNC commands, refer to wou.h
+ **/
+void wou_sync_cmd (wou_param_t *w_param, const uint16_t *cmds, int n)
+{
+    board_sync_push (w_param->board, cmds, n);
+}
+
+void wou_sync_jnt (wou_param_t *w_param, int dir, uint16_t pos)
+{
+    uint16_t    sync_cmd;
+
+    sync_cmd = SYNC_JNT | (dir ? DIR_P : DIR_N) | (POS_MASK & pos);
+    board_sync_push (w_param->board, &sync_cmd, 1);
+}
+
+void wou_sync_dout (wou_param_t *w_param, uint8_t id, uint8_t val)
+{
+    uint16_t    sync_cmd;
+
+    sync_cmd = SYNC_DOUT | PACK_IO_ID(id) | PACK_DO_VAL(val);
+    board_sync_push (w_param->board, &sync_cmd, 1);
+}
+
+void wou_sync_din (wou_param_t *w_param, uint8_t id, uint8_t type)
+{
+    uint16_t    sync_cmd;
+
+    sync_cmd = SYNC_DIN | PACK_IO_ID(id) | PACK_DI_TYPE(type);
+    board_sync_push (w_param->board, &sync_cmd, 1);
+}
+
+void wou_sync_vel (wou_param_t *w_param, uint16_t vel, uint8_t sync)
+{
+    uint16_t    sync_cmd;
+
+    sync_cmd = SYNC_VEL | ((vel << 1) & VEL_MASK) | (sync & VEL_SYNC_MASK);
+    board_sync_push (w_param->board, &sync_cmd, 1);
+}
+
+void wou_sync_data (wou_param_t *w_param, const uint8_t *data, int n)
+{
+    uint16_t    sync_cmd[SYNC_CMD_MAX / sizeof(uint16_t)];
+    int         i;
+    int         j;
+
+    for (i = 0; i < n; i += j) {
+        for (j = 0; (j < (int) (SYNC_CMD_MAX / sizeof(uint16_t))) && ((i + j) < n); j++) {
+            sync_cmd[j] = SYNC_DATA | PACK_SYNC_DATA(data[i + j]);
+        }
+        board_sync_push (w_param->board, sync_cmd, j);
+    }
+}
+
+/**
+ * board_sync_data_cmd - pack 4 bytes of immediate data followed by the
+ *                       command into cmds[SYNC_DATA_CMD_WORDS]
+ *  return cmds past the packed words
+ **/
+uint16_t *board_sync_data_cmd (uint16_t *cmds, uint32_t val, uint16_t cmd)
+{
+    int         j;
+
+    for (j = 0; j < (int) sizeof(uint32_t); j++) {
+        *cmds++ = SYNC_DATA | PACK_SYNC_DATA(((uint8_t *) &val)[j]);
+    }
+    *cmds++ = cmd;
+    return cmds;
+}
+
+static void sync_data_cmd (wou_param_t *w_param, uint32_t val, uint16_t cmd)
+{
+    uint16_t    sync_cmd[SYNC_DATA_CMD_WORDS];
+
+    board_sync_data_cmd (sync_cmd, val, cmd);
+    board_sync_push (w_param->board, sync_cmd, SYNC_DATA_CMD_WORDS);
+}
+
+void wou_sync_mot_param (wou_param_t *w_param, uint8_t joint, uint16_t addr, 
+                         uint32_t val)
+{
+    sync_data_cmd (w_param, val, 
+                   SYNC_MOT_PARAM | PACK_MOT_PARAM_ADDR(addr) | PACK_MOT_PARAM_ID(joint));
+}
+
+void wou_sync_mach_param (wou_param_t *w_param, uint16_t addr, uint32_t val)
+{
+    sync_data_cmd (w_param, val, SYNC_MACH_PARAM | PACK_MACH_PARAM_ADDR(addr));
+}
+
+void wou_sync_usb_cmd (wou_param_t *w_param, uint16_t type, uint32_t val)
+{
+    sync_data_cmd (w_param, val, SYNC_USB_CMD | PACK_USB_CMD_TYPE(type));
+}
+
+void wou_sync_eof (wou_param_t *w_param)
+{
+    uint16_t    sync_cmd;
+
+    sync_cmd = SYNC_EOF;
+    board_sync_push (w_param->board, &sync_cmd, 1);
+}
+
+/**
+ * joint-delta encoder
+ *  joints are processed as JNT_VECS vectors of 4 int64 lanes (GCC vector
+ *  extensions), unused lanes stay 0
+ **/
+#define JNT_LANES   4
+#define JNT_VECS    ((WOU_MAX_JOINTS + JNT_LANES - 1) / JNT_LANES)
+#define JNT_ROWS    16      // rows per wou_jnt_encode() in wou_sync_jnts()
+
+typedef int64_t v4di __attribute__ ((vector_size (JNT_LANES * sizeof(int64_t))));
+
+typedef union {
+    v4di        v[JNT_VECS];
+    int64_t     s[JNT_VECS * JNT_LANES];
+} jnt_vec_t;
+
+void wou_jnt_enc_init (wou_jnt_enc_t *enc, int njoints, int frac_bits,
+                       const int64_t *pos)
+{
+    assert ((njoints > 0) && (njoints <= WOU_MAX_JOINTS));
+    assert ((frac_bits >= 0) && (frac_bits < 32));
+    memset (enc, 0, sizeof(wou_jnt_enc_t));
+    enc->njoints = njoints;
+    enc->frac_bits = frac_bits;
+    if (pos) {
+        memcpy (enc->prev, pos, njoints * sizeof(int64_t));
+    }
+}
+
+/* store one row of signed steps as {DIR_W, POS_W} */
+static inline void jnt_row (const jnt_vec_t *step, int njoints, uint16_t *cmds)
+{
+    jnt_vec_t   w;
+    v4di        m;
+    int         i;
+
+    for (i = 0; i < JNT_VECS; i++) {
+        m = step->v[i] >> 63;   // -1 for negative lanes
+        w.v[i] = ((step->v[i] ^ m) - m) | (~m & DIR_P) | SYNC_JNT;
+    }
+    for (i = 0; i < njoints; i++) {
+        cmds[i] = (uint16_t) w.s[i];
+    }
+}
+
+int wou_jnt_encode (wou_jnt_enc_t *enc, const int64_t *target, uint16_t *cmds,
+                    int max_cmds)
+{
+    jnt_vec_t   tgt;
+    jnt_vec_t   prev;
+    jnt_vec_t   delta;
+    jnt_vec_t   step;
+    v4di        m;
+    v4di        amax;
+    v4di        half;
+    v4di        vrows;
+    v4di        over;
+    v4di        under;
+    jnt_vec_t   q;
+    jnt_vec_t   rem;
+    jnt_vec_t   acc;
+    jnt_vec_t   sum;
+    int64_t     dmax;
+    int64_t     rows;
+    int         n;
+    int         r;
+    int         i;
+
+    n = enc->njoints;
+    memset (&tgt, 0, sizeof(tgt));
+    memset (&prev, 0, sizeof(prev));
+    memcpy (tgt.s, target, n * sizeof(int64_t));
+    memcpy (prev.s, enc->prev, n * sizeof(int64_t));
+
+    // round to pulses and take the absolute maximum
+    half = (v4di) {0, 0, 0, 0} + ((enc->frac_bits) ? ((int64_t) 1 << (enc->frac_bits - 1)) : 0);
+    amax = (v4di) {0, 0, 0, 0};
+    for (i = 0; i < JNT_VECS; i++) {
+        delta.v[i] = ((tgt.v[i] + half) >> enc->frac_bits) - prev.v[i];
+        m = delta.v[i] >> 63;
+        amax |= (delta.v[i] ^ m) - m;   // an upper bound is enough for rows
+    }
+    dmax = 0;
+    for (i = 0; i < JNT_LANES; i++) {
+        dmax |= amax[i];
+    }
+    if (dmax > POS_MASK) {
+        // dmax is OR'ed; find the exact maximum for the number of rows
+        dmax = 0;
+        for (i = 0; i < n; i++) {
+            dmax = MAX(dmax, llabs (delta.s[i]));
+        }
+    }
+    rows = (dmax + POS_MASK - 1) / POS_MASK;
+    if (rows == 0) {
+        rows = 1;
+    }
+
+    if (rows == 1) {
+        if (max_cmds < n) {
+            enc->pending = 1;
+            return 0;
+        }
+        jnt_row (&delta, n, cmds);
+        for (i = 0; i < JNT_VECS; i++) {
+            prev.v[i] += delta.v[i];
+        }
+        r = 1;
+    } else {
+        // spread delta evenly: step[r] = d*(r+1)/rows - d*r/rows, which
+        // is d/rows plus a carry of the remainder, Bresenham style
+        enc->splits ++;
+        vrows = (v4di) {0, 0, 0, 0} + rows;
+        for (i = 0; i < JNT_VECS; i++) {
+            q.v[i] = delta.v[i] / rows;
+            rem.v[i] = delta.v[i] - q.v[i] * rows;
+            acc.v[i] = (v4di) {0, 0, 0, 0};
+            sum.v[i] = (v4di) {0, 0, 0, 0};
+        }
+        for (r = 0; (r < rows) && ((r + 1) * n <= max_cmds); r++) {
+            for (i = 0; i < JNT_VECS; i++) {
+                acc.v[i] += rem.v[i];
+                over = acc.v[i] >= vrows;       // -1 where it carries
+                under = acc.v[i] <= -vrows;
+                step.v[i] = q.v[i] - over + under;
+                acc.v[i] += (under & vrows) - (over & vrows);
+                sum.v[i] += step.v[i];
+            }
+            jnt_row (&step, n, cmds + r * n);
+        }
+        for (i = 0; i < JNT_VECS; i++) {
+            prev.v[i] += sum.v[i];
+        }
+    }
+
+    memcpy (enc->prev, prev.s, n * sizeof(int64_t));
+    for (i = 0; i < JNT_VECS; i++) {
+        delta.v[i] = tgt.v[i] - (prev.v[i] << enc->frac_bits);
+    }
+    memcpy (enc->residual, delta.s, n * sizeof(int64_t));
+    enc->pending = rows - r;
+    return r * n;
+}
+
+int wou_sync_jnts (wou_param_t *w_param, wou_jnt_enc_t *enc, const int64_t *target)
+{
+    uint16_t    cmds[JNT_ROWS * WOU_MAX_JOINTS];
+    int         rows;
+    int         n;
+
+    rows = 0;
+    do {
+        n = wou_jnt_encode (enc, target, cmds, JNT_ROWS * enc->njoints);
+        board_sync_push (w_param->board, cmds, n);
+        rows += n / enc->njoints;
+    } while (enc->pending);
+    return rows;
+}
+
+// vim:sw=4:sts=4:et:
@@ -0,0 +1,182 @@
+/**
+ * tmpl.c - WOU_FRAME templates for recurring servo cycles
+ *
+ * A template records the layout of a WOU_FRAME once. Every cycle only
+ * the DATA of recorded WB_WR_CMD packets and the TID are patched.
+ * CRC-16 is linear (INITIAL_REMAINDER is 0), so the CRC change of a
+ * patch is the remainder of the XOR delta advanced over the bytes
+ * following the patch. The advance is a 16x16 GF(2) matrix, which is
+ * kept as two 256-entry tables per field.
+ *
+ * Copyright (C) 2009 Yishin Li <ysli@araisrobo.com>
+ **/
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <config.h>
+#ifdef HAVE_LIBFTD2XX
+#include <ftd2xx.h>     // from FTDI
+#else
+#ifdef HAVE_LIBFTDI
+#include <ftdi.h>       // from FTDI
+#endif  // HAVE_LIBFTDI
+#endif  // HAVE_LIBFTD2XX
+
+#include "wb_regs.h"
+#include "wou.h"
+#include "board.h"
+#include "crc.h"
+
+/**
+ * field_init - build the CRC advance tables of a field
+ * @tail:   number of CRC covered bytes after the field
+ **/
+static void field_init (wouf_field_t *f, uint16_t offset, uint16_t dsize, int tail)
+{
+    uint16_t    basis[16];
+    int         k;
+    int         v;
+
+    f->offset = offset;
+    f->dsize = dsize;
+    for (k = 0; k < 16; k++) {
+        basis[k] = crcFinal (crcZeros ((crc) (1 << k), tail)) ^ crcFinal (0);
+    }
+    for (v = 0; v < 256; v++) {
+        f->adv[0][v] = 0;
+        f->adv[1][v] = 0;
+        for (k = 0; k < 8; k++) {
+            if (v & (1 << k)) {
+                f->adv[0][v] ^= basis[k];
+                f->adv[1][v] ^= basis[k + 8];
+            }
+        }
+    }
+}
+
+/**
+ * field_patch - write data into the field and patch the CRC
+ **/
+static void field_patch (struct wouf_tmpl *t, const wouf_field_t *f,
+                         const uint8_t *data)
+{
+    uint8_t     delta[MAX_DSIZE];
+    uint8_t     *p;
+    uint16_t    crc16;
+    crc         r;
+    int         i;
+
+    p = t->wouf.buf + f->offset;
+    for (i = 0; i < f->dsize; i++) {
+        delta[i] = p[i] ^ data[i];
+        p[i] = data[i];
+    }
+    r = crcRemainder (0, delta, f->dsize);
+
+    memcpy (&crc16, t->wouf.buf + t->wouf.fsize - CRC_SIZE, CRC_SIZE);
+    crc16 ^= f->adv[0][r & 0xFF] ^ f->adv[1][r >> 8];
+    memcpy (t->wouf.buf + t->wouf.fsize - CRC_SIZE, &crc16, CRC_SIZE);
+}
+
+struct wouf_tmpl *wouf_tmpl_new (void)
+{
+    struct wouf_tmpl *t;
+
+    t = (struct wouf_tmpl *) malloc (sizeof(struct wouf_tmpl));
+    if (t == NULL) {
+        return NULL;
+    }
+    wouf_clear (&(t->wouf));
+    t->sealed = 0;
+    t->nfields = 0;
+    return t;
+}
+
+void wouf_tmpl_free (struct wouf_tmpl *t)
+{
+    free (t);
+}
+
+/**
+ * wouf_tmpl_cmd - record a [WOU] packet
+ **/
+int wouf_tmpl_cmd (struct wouf_tmpl *t, const uint8_t func, const uint16_t wb_addr,
+                   const uint16_t dsize, const uint8_t *data, int *field)
+{
+    if (t->sealed || (dsize > MAX_DSIZE) ||
+        ((func != WB_WR_CMD) && (func != WB_RD_CMD))) {
+        return INVALID_DATA;
+    }
+    if (!wouf_fits (&(t->wouf), func, dsize)) {
+        return -ENOSPC;
+    }
+    if (func == WB_WR_CMD) {
+        if (t->nfields == WOUF_TMPL_FIELDS) {
+            return -ENOSPC;
+        }
+        // field_init() needs the final fsize; keep offset and dsize for now
+        t->field[t->nfields].offset = t->wouf.fsize + WOU_HDR_SIZE;
+        t->field[t->nfields].dsize = dsize;
+        if (field) {
+            *field = t->nfields;
+        }
+        t->nfields ++;
+    }
+    wouf_put (&(t->wouf), func, wb_addr, dsize, data);
+    return 0;
+}
+
+/**
+ * wouf_tmpl_seal - fill in the header and CRC; the same as wouf_seal() with TID 0
+ **/
+int wouf_tmpl_seal (struct wouf_tmpl *t)
+{
+    wouf_t      *wou_frame_;
+    uint16_t    crc16;
+    int         i;
+
+    if (t->sealed) {
+        return INVALID_DATA;
+    }
+    wou_frame_ = &(t->wouf);
+    wou_frame_->buf[3] = 0xFF & (wou_frame_->fsize - WOUF_HDR_SIZE);
+    wou_frame_->buf[4] = TYP_WOUF;
+    wou_frame_->buf[5] = 0;
+    wou_frame_->buf[6] = 0xFF & (wou_frame_->pload_size_rx);
+    assert(wou_frame_->buf[3] > 2); // PLOAD_SIZE_TX: 0x03 ~ 0xFF
+
+    crc16 = crcFast(wou_frame_->buf + (WOUF_HDR_SIZE - 1),
+                    wou_frame_->fsize - (WOUF_HDR_SIZE - 1));
+    memcpy (wou_frame_->buf + wou_frame_->fsize, &crc16, CRC_SIZE);
+
+    for (i = 0; i < t->nfields; i++) {
+        field_init (&(t->field[i]), t->field[i].offset, t->field[i].dsize,
+                    wou_frame_->fsize - (t->field[i].offset + t->field[i].dsize));
+    }
+    field_init (&(t->tid), 5, 1, wou_frame_->fsize - (5 + 1));
+
+    wou_frame_->fsize += CRC_SIZE;
+    t->sealed = 1;
+    return 0;
+}
+
+int wouf_tmpl_patch (struct wouf_tmpl *t, int field, const uint8_t *data)
+{
+    if (!t->sealed || (field < 0) || (field >= t->nfields)) {
+        return INVALID_DATA;
+    }
+    field_patch (t, &(t->field[field]), data);
+    return 0;
+}
+
+void wouf_tmpl_tid (struct wouf_tmpl *t, uint8_t tid)
+{
+    field_patch (t, &(t->tid), &tid);
+}
+
+// vim:sw=4:sts=4:et:
@@ -0,0 +1,67 @@
+/**
+ * wou_log.h - file format of wou_log_open()
+ *
+ *   wlog_hdr_t | wlog_col_t[ncols] | pad to hdr_size |
+ *   block | block | ...
+ *
+ * a block holds block_rows records column by column:
+ *
+ *   wlog_blk_t | column 0, block_rows values | column 1 ...
+ *
+ * only the first wlog_blk_t.rows values of each column are valid.
+ * All values are little-endian, as written by the host.
+ **/
+#ifndef __wou_log_h__
+#define __wou_log_h__
+
+#include <stdint.h>
+
+#define WLOG_MAGIC      0x474F4C57  // "WLOG"
+#define WLOG_BLK_MAGIC  0x4B4C4257  // "WBLK"
+#define WLOG_VERSION    1
+#define WLOG_NAME_SIZE  16
+#define WLOG_HDR_ALIGN  64
+
+// type of a column
+#define WLOG_U64        0x00        // rx_time_ns
+#define WLOG_U32        0x01
+#define WLOG_I32        0x02
+
+/**
+ * wlog_hdr_t - head of a log file
+ * @ncols:      columns of each record
+ * @block_rows: records per block
+ * @hdr_size:   offset of the first block
+ * @blk_size:   size of a block in bytes, wlog_blk_t included
+ **/
+typedef struct {
+    uint32_t    magic;
+    uint16_t    version;
+    uint16_t    ncols;
+    uint32_t    block_rows;
+    uint32_t    hdr_size;
+    uint32_t    blk_size;
+    uint32_t    reserved;
+} wlog_hdr_t;
+
+/**
+ * wlog_col_t - a column
+ * @name:       NUL terminated
+ * @type:       WLOG_*
+ * @width:      bytes per value
+ * @wb_addr:    register sampled into the column, 0 for mail fields
+ **/
+typedef struct {
+    char        name[WLOG_NAME_SIZE];
+    uint8_t     type;
+    uint8_t     width;
+    uint16_t    wb_addr;
+    uint32_t    reserved;
+} wlog_col_t;
+
+typedef struct {
+    uint32_t    magic;
+    uint32_t    rows;
+} wlog_blk_t;
+
+#endif // __wou_log_h__
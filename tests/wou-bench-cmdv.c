@@ -0,0 +1,108 @@
+/**
+ * wou-bench-cmdv.c - benchmark wou_cmdv() against per-call wou_cmd()
+ *
+ * a servo cycle of NR_OPS register writes and reads is issued both ways;
+ * the link is taken as lost, so sealed woufs stay in WOUFS and no USB
+ * I/O happens: this is the caller-side CPU of building the woufs, and
+ * no board is needed
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <config.h>
+#ifdef HAVE_LIBFTDI
+#include <ftdi.h>
+#endif
+
+#include "wb_regs.h"
+#include "wou.h"
+#include "wou/board.h"
+
+#define NR_OPS      48      // commands per servo cycle
+#define NR_CYCLES   100     // servo cycles per round, within WOUFS
+#define NR_ROUNDS   1000
+
+static uint64_t now_ns (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* a fresh WOUFS whose link is down, so sealing does no USB I/O */
+static void woufs_reset (wou_param_t *w)
+{
+    free (w->board->wou);
+    board_init (w->board, "7i43u", 0, NULL);
+    w->board->wou->link.lost = 1;
+    w->board->wou->link.t_retry = UINT64_MAX;
+}
+
+int main(void)
+{
+    static uint8_t  data[NR_OPS][16];
+    wou_op_t        ops[NR_OPS];
+    wou_param_t     w;
+    uint64_t        t;
+    uint64_t        t_cmd;
+    uint64_t        t_cmdv;
+    int             woufs_cmd;
+    int             woufs_cmdv;
+    int             r;
+    int             c;
+    int             i;
+
+    // 4-byte writes, a 16-byte write every 8th, a 4-byte read every 6th
+    for (i = 0; i < NR_OPS; i++) {
+        memset (data[i], i, sizeof(data[i]));
+        ops[i].func = ((i % 6) == 5) ? WB_RD_CMD : WB_WR_CMD;
+        ops[i].wb_addr = JCMD_BASE + 4 * i;
+        ops[i].dsize = ((i % 8) == 7) ? 16 : 4;
+        ops[i].data = data[i];
+    }
+
+    printf("wou_cmdv() vs. per-call wou_cmd(), %d commands per cycle, %d cycles\n",
+           NR_OPS, NR_CYCLES * NR_ROUNDS);
+
+    wou_init (&w, "7i43u", 0, NULL);
+
+    t_cmd = 0;
+    woufs_cmd = 0;
+    for (r = 0; r < NR_ROUNDS; r++) {
+        woufs_reset (&w);
+        t = now_ns ();
+        for (c = 0; c < NR_CYCLES; c++) {
+            for (i = 0; i < NR_OPS; i++) {
+                wou_cmd (&w, ops[i].func, ops[i].wb_addr, ops[i].dsize, ops[i].data);
+            }
+        }
+        t_cmd += now_ns () - t;
+        woufs_cmd = wou_occupancy (w.board);
+    }
+    printf("wou_cmd:  %6.1f ns/cycle, %d woufs per round\n",
+           (double) t_cmd / (NR_CYCLES * NR_ROUNDS), woufs_cmd);
+
+    t_cmdv = 0;
+    woufs_cmdv = 0;
+    for (r = 0; r < NR_ROUNDS; r++) {
+        woufs_reset (&w);
+        t = now_ns ();
+        for (c = 0; c < NR_CYCLES; c++) {
+            wou_cmdv (&w, ops, NR_OPS);
+        }
+        t_cmdv += now_ns () - t;
+        woufs_cmdv = wou_occupancy (w.board);
+    }
+    printf("wou_cmdv: %6.1f ns/cycle, %d woufs per round\n",
+           (double) t_cmdv / (NR_CYCLES * NR_ROUNDS), woufs_cmdv);
+
+    if (woufs_cmd != woufs_cmdv) {
+        printf("ERROR: wou_cmd() and wou_cmdv() sealed different woufs\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,168 @@
+/**
+ * wou-bench-mailbox.c - benchmark wou_mail_dispatch() against the
+ *                       hand-rolled fetchmail() pattern
+ *
+ * mails are laid out at odd addresses as in buf_rx[]; no board is needed
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "wou.h"
+#include "wb_regs.h"
+#include "mailtag.h"
+
+#define NR_MAILS    4096
+#define NR_ROUNDS   1000
+#define NR_JOINTS   4
+#define MAIL_STRIDE 64
+
+static uint8_t  mails[NR_MAILS * MAIL_STRIDE + 1];
+
+static uint64_t now_ns (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* {PLOAD_SIZE_TX, MAILBOX, tag, words} */
+static void put_mail (uint8_t *buf, uint16_t tag, const uint32_t *words, int n)
+{
+    buf[0] = MAIL_HDR_SIZE - 1 + n * sizeof(uint32_t);
+    buf[1] = MAILBOX;
+    memcpy (buf + 2, &tag, sizeof(uint16_t));
+    memcpy (buf + MAIL_HDR_SIZE, words, n * sizeof(uint32_t));
+}
+
+/* the pattern of fetchmail() in wou-unit-test-spi.c */
+static int64_t naive_fetch (const uint8_t *buf_head)
+{
+    uint16_t    mail_tag;
+    uint32_t    *p;
+    int64_t     sum;
+    int         i;
+
+    sum = 0;
+    memcpy (&mail_tag, (buf_head + 2), sizeof(uint16_t));
+    if (mail_tag == MT_MOTION_STATUS) {
+        p = (uint32_t *) (buf_head + 4);
+        sum += *p;
+        for (i = 0; i < NR_JOINTS; i++) {
+            p += 1;
+            sum += (int32_t) *p;
+            p += 1;
+            sum += (int32_t) *p;
+        }
+        p += 1;
+        sum += (int32_t) *p;
+    } else if (mail_tag == MT_ERROR_CODE) {
+        p = (uint32_t *) (buf_head + 4);
+        sum += *p;
+        p += 1;
+        sum += *p;
+    } else if (mail_tag == MT_TICK) {
+        p = (uint32_t *) (buf_head + 4);
+        sum += *p;
+    }
+    return sum;
+}
+
+static void on_motion (void *ctx, const void *view, uint32_t size, uint64_t t)
+{
+    const mail_motion_status_t *m = view;
+    const mail_word_t *adc;
+    int64_t     *sum = ctx;
+    int         i;
+
+    *sum += m->bp_tick;
+    for (i = 0; i < NR_JOINTS; i++) {
+        *sum += m->jnt[i].pulse_pos;
+        *sum += m->jnt[i].enc_pos;
+    }
+    adc = (const mail_word_t *) &(m->jnt[NR_JOINTS]);
+    *sum += (int32_t) adc->word;
+}
+
+static void on_error (void *ctx, const void *view, uint32_t size, uint64_t t)
+{
+    const mail_error_code_t *m = view;
+    int64_t     *sum = ctx;
+
+    *sum += m->bp_tick;
+    *sum += m->code;
+}
+
+static void on_tick (void *ctx, const void *view, uint32_t size, uint64_t t)
+{
+    const mail_tick_t *m = view;
+    int64_t     *sum = ctx;
+
+    *sum += m->bp_tick;
+}
+
+int main(void)
+{
+    wou_mail_dispatch_t d;
+    uint32_t        words[2 + 2 * NR_JOINTS];
+    uint8_t         *base;
+    uint64_t        t0;
+    int64_t         sum_naive;
+    int64_t         sum_dispatch;
+    int             r;
+    int             i;
+    int             j;
+
+    // mostly MT_MOTION_STATUS, an MT_ERROR_CODE and an MT_TICK now and then
+    base = mails + 1;
+    srand (1);
+    for (i = 0; i < NR_MAILS; i++) {
+        for (j = 0; j < (int) (sizeof(words) / sizeof(words[0])); j++) {
+            words[j] = rand () - RAND_MAX / 2;
+        }
+        if ((i % 16) == 7) {
+            put_mail (base + i * MAIL_STRIDE, MT_ERROR_CODE, words, 2);
+        } else if ((i % 16) == 15) {
+            put_mail (base + i * MAIL_STRIDE, MT_TICK, words, 1);
+        } else {
+            put_mail (base + i * MAIL_STRIDE, MT_MOTION_STATUS, words, 2 + 2 * NR_JOINTS);
+        }
+    }
+
+    printf("%d mails x %d rounds, %d joints\n", NR_MAILS, NR_ROUNDS, NR_JOINTS);
+
+    sum_naive = 0;
+    t0 = now_ns ();
+    for (r = 0; r < NR_ROUNDS; r++) {
+        for (i = 0; i < NR_MAILS; i++) {
+            sum_naive += naive_fetch (base + i * MAIL_STRIDE);
+        }
+    }
+    t0 = now_ns () - t0;
+    printf("fetchmail():         %5.2f ns/mail\n", (double) t0 / NR_ROUNDS / NR_MAILS);
+
+    sum_dispatch = 0;
+    wou_mail_dispatch_init (&d);
+    wou_mail_on (&d, MT_MOTION_STATUS, on_motion, &sum_dispatch);
+    wou_mail_on (&d, MT_ERROR_CODE, on_error, &sum_dispatch);
+    wou_mail_on (&d, MT_TICK, on_tick, &sum_dispatch);
+    t0 = now_ns ();
+    for (r = 0; r < NR_ROUNDS; r++) {
+        for (i = 0; i < NR_MAILS; i++) {
+            wou_mail_dispatch (&d, base + i * MAIL_STRIDE, 0);
+        }
+    }
+    t0 = now_ns () - t0;
+    printf("wou_mail_dispatch(): %5.2f ns/mail, %llu dispatched, %llu short\n",
+           (double) t0 / NR_ROUNDS / NR_MAILS,
+           (unsigned long long) d.dispatched, (unsigned long long) d.short_mails);
+
+    if (sum_naive != sum_dispatch) {
+        printf("ERROR: checksum mismatch\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,105 @@
+/**
+ * wou-bench-sync-jnt.c - benchmark wou_jnt_encode() across 12 joints
+ *
+ * compares the encoder with the hand-rolled per-joint SYNC_JNT loop;
+ * no board is needed
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "wou.h"
+#include "sync_cmd.h"
+
+#define NR_CYCLES   1000000
+#define NR_PATH     4096
+
+static uint64_t now_ns (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* the hand-rolled pattern: clamp to 13 bits, one joint at a time */
+static int naive_encode (int64_t *prev, const int64_t *target, uint16_t *cmds)
+{
+    int64_t     d;
+    int         i;
+
+    for (i = 0; i < WOU_MAX_JOINTS; i++) {
+        d = target[i] - prev[i];
+        if (d > POS_MASK) {
+            d = POS_MASK;
+        } else if (d < -POS_MASK) {
+            d = -POS_MASK;
+        }
+        if (d >= 0) {
+            cmds[i] = SYNC_JNT | DIR_P | (POS_MASK & d);
+        } else {
+            cmds[i] = SYNC_JNT | DIR_N | (POS_MASK & -d);
+        }
+        prev[i] += d;
+    }
+    return WOU_MAX_JOINTS;
+}
+
+int main(void)
+{
+    static int64_t  path[NR_PATH][WOU_MAX_JOINTS];
+    int64_t         prev[WOU_MAX_JOINTS];
+    uint16_t        cmds[64 * WOU_MAX_JOINTS];
+    wou_jnt_enc_t   enc;
+    uint64_t        t0;
+    uint64_t        words;
+    int             i;
+    int             j;
+
+    // random path in 16.16 pulses, every 64th cycle jumps beyond 8191
+    srand (1);
+    for (j = 0; j < WOU_MAX_JOINTS; j++) {
+        path[0][j] = 0;
+    }
+    for (i = 1; i < NR_PATH; i++) {
+        for (j = 0; j < WOU_MAX_JOINTS; j++) {
+            path[i][j] = path[i - 1][j] + ((int64_t) (rand () % 8000 - 4000) << 16);
+            if ((i % 64) == 0) {
+                path[i][j] += (int64_t) 20000 << 16;
+            }
+        }
+    }
+
+    printf("wou_jnt_encode() vs. per-joint loop, %d joints, %d cycles\n",
+           WOU_MAX_JOINTS, NR_CYCLES);
+
+    memset (prev, 0, sizeof(prev));
+    words = 0;
+    t0 = now_ns ();
+    for (i = 0; i < NR_CYCLES; i++) {
+        int64_t tgt[WOU_MAX_JOINTS];
+        for (j = 0; j < WOU_MAX_JOINTS; j++) {
+            tgt[j] = path[i % NR_PATH][j] >> 16;
+        }
+        words += naive_encode (prev, tgt, cmds);
+    }
+    t0 = now_ns () - t0;
+    printf("per-joint: %6.1f ns/cycle, %llu words (clamped, no residual)\n",
+           (double) t0 / NR_CYCLES, (unsigned long long) words);
+
+    wou_jnt_enc_init (&enc, WOU_MAX_JOINTS, 16, NULL);
+    words = 0;
+    t0 = now_ns ();
+    for (i = 0; i < NR_CYCLES; i++) {
+        do {
+            words += wou_jnt_encode (&enc, path[i % NR_PATH], cmds, 64 * WOU_MAX_JOINTS);
+        } while (enc.pending);
+    }
+    t0 = now_ns () - t0;
+    printf("encoder:   %6.1f ns/cycle, %llu words, %u splits\n",
+           (double) t0 / NR_CYCLES, (unsigned long long) words, enc.splits);
+
+    return 0;
+}